@@ -4,6 +4,359 @@
 #include <chrono>
 using namespace::std::literals;
 
+// Local object store. Objects are filed under a hash of the preprocessed source, the compiler
+// and the flags, so a translation unit that was compiled before is copied back instead.
+struct CompileCache {
+    std::filesystem::path mDirectory;
+    std::string mCompilerIdentity;
+    bool mLookup = true;
+};
+
+// One compiler invocation. Its output is kept until it finishes and then logged in one piece,
+// so the lines of jobs running side by side never mix.
+struct CompileJob {
+    std::filesystem::path mObject;
+    std::filesystem::path mDepFile;
+    std::string mCommand;
+    std::string mOutput;
+    int mExitCode = -1;
+    bool mStarted = false;
+    std::chrono::steady_clock::duration mElapsed{};
+
+    // Set when the compile cache is in use
+    const CompileCache* mCache = nullptr;
+    std::string mPreprocessCommand;
+    std::string mFlags;
+    uint64_t mHash = 0;
+    size_t mPreprocessedSize = 0;
+    std::filesystem::path mCacheEntry;
+    bool mCacheHit = false;
+    // When the preprocessor started, and the source and headers it read with their modification times
+    std::filesystem::file_time_type mPreprocessStart;
+    std::vector<std::pair<std::filesystem::path, std::filesystem::file_time_type>> mInputs;
+};
+
+static double ToSeconds(std::chrono::steady_clock::duration duration) {
+    return std::chrono::duration<double>(duration).count();
+}
+
+static bool RunProcess(const std::string& command, std::string& output, int& exitCode) {
+    SubProcess process;
+    if (!process.create(command, SubProcessFlags::RedirectOutput)) {
+        return false;
+    }
+
+    process.read([&output](const std::string& text) {
+        output += text;
+    });
+    exitCode = process.wait();
+    return true;
+}
+
+// FNV-1a, can be continued chunk by chunk
+static uint64_t HashBytes(std::string_view bytes, uint64_t hash = 14695981039346656037ull) {
+    for (unsigned char c : bytes) {
+        hash = (hash ^ c) * 1099511628211ull;
+    }
+    return hash;
+}
+
+// The compiler output (warnings) of an entry, replayed when the entry is used
+static std::filesystem::path GetCacheLogPath(const std::filesystem::path& entry) {
+    std::filesystem::path log = entry;
+    log += ".log";
+    return log;
+}
+
+static uintmax_t GetDirectorySize(const std::filesystem::path& directory) {
+    std::error_code ec;
+    uintmax_t size = 0;
+    for (const auto& entry : std::filesystem::directory_iterator(directory, ec)) {
+        if (entry.is_regular_file(ec)) {
+            size += entry.file_size(ec);
+        }
+    }
+    return size;
+}
+
+static bool RestoreFromCache(CompileJob& job) {
+    std::error_code ec;
+    if (job.mCacheEntry.empty() || !job.mCache->mLookup || 
+        !std::filesystem::copy_file(job.mCacheEntry, job.mObject, std::filesystem::copy_options::overwrite_existing, ec)) {
+        return false;
+    }
+
+    // The copy may keep the entry's old time, which would look stale next to the headers
+    std::filesystem::last_write_time(job.mObject, std::filesystem::file_time_type::clock::now(), ec);
+
+    std::ifstream log(GetCacheLogPath(job.mCacheEntry), std::ios::binary);
+    job.mOutput.assign(std::istreambuf_iterator<char>(log), std::istreambuf_iterator<char>());
+    job.mStarted = true;
+    job.mCacheHit = true;
+    job.mExitCode = 0;
+    return true;
+}
+
+static bool ReadDepFile(const std::filesystem::path& path, std::vector<std::filesystem::path>& deps);
+
+static bool RecordInputs(CompileJob& job) {
+    std::vector<std::filesystem::path> deps;
+    if (!ReadDepFile(job.mDepFile, deps)) {
+        return false;
+    }
+
+    std::error_code ec;
+    job.mInputs.clear();
+    for (auto& dep : deps) {
+        auto time = std::filesystem::last_write_time(dep, ec);
+        if (ec) {
+            return false;
+        }
+        job.mInputs.emplace_back(std::move(dep), time);
+    }
+    return true;
+}
+
+// The hash only describes the object when the compiler read the same files as the preprocessor.
+// Anything saved since the preprocessor started may have been compiled in its new state.
+static bool InputsUnchanged(const CompileJob& job) {
+    std::vector<std::filesystem::path> deps;
+    if (!ReadDepFile(job.mDepFile, deps) || deps.size() != job.mInputs.size()) {
+        return false;
+    }
+
+    std::error_code ec;
+    for (size_t i = 0; i < deps.size(); i++) {
+        auto time = std::filesystem::last_write_time(deps[i], ec);
+        if (ec || deps[i] != job.mInputs[i].first || time != job.mInputs[i].second || time >= job.mPreprocessStart) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static void StoreInCache(const CompileJob& job) {
+    if (job.mCacheEntry.empty() || job.mExitCode != 0 || !InputsUnchanged(job)) {
+        return;
+    }
+
+    // A half written entry must never be found, every job copies under a name of its own first.
+    // The log goes in before the object, an entry that can be found always has its warnings.
+    std::error_code ec;
+    std::filesystem::path temp = job.mCacheEntry;
+    temp += std::format(".{:016x}.tmp", HashBytes(job.mObject.string()));
+    {
+        std::ofstream log(temp, std::ios::binary | std::ios::trunc);
+        log << job.mOutput;
+    }
+    std::filesystem::rename(temp, GetCacheLogPath(job.mCacheEntry), ec);
+    if (!ec && std::filesystem::copy_file(job.mObject, temp, std::filesystem::copy_options::overwrite_existing, ec)) {
+        std::filesystem::rename(temp, job.mCacheEntry, ec);
+    }
+    std::filesystem::remove(temp, ec);
+}
+
+// Runs the jobs on up to jobCount processes at once, all of them served by one poll loop on this thread.
+// onDone is called for every finished job in the order they finish. Returns true when all of them succeeded.
+static bool RunCompileJobs(std::vector<CompileJob>& jobs, unsigned jobCount, std::function<void(CompileJob&, size_t done)> onDone) {
+    if (jobCount == 0) {
+        jobCount = std::max(std::thread::hardware_concurrency(), 1u);
+    }
+
+    SubProcessPoller poller;
+    size_t next = 0;
+    size_t running = 0;
+    size_t done = 0;
+
+    auto finish = [&] (CompileJob& job) {
+        running--;
+        onDone(job, ++done);
+    };
+
+    auto compile = [&] (CompileJob& job) {
+        auto process = std::make_shared<SubProcess>();
+        if (!process->create(job.mCommand, SubProcessFlags::RedirectOutput)) {
+            finish(job);
+            return;
+        }
+        job.mStarted = true;
+
+        poller.add(process, [&job] (SubProcessStream, std::string_view text) {
+            job.mOutput += text;
+        }, [&, process] (int exitCode) {
+            job.mExitCode = exitCode;
+            job.mElapsed = process->getElapsedTime();
+            StoreInCache(job);
+            finish(job);
+        });
+    };
+
+    // With the cache on, a job first runs the preprocessor. Its output is hashed as it streams in,
+    // diagnostics are left for the compiler to report.
+    auto preprocess = [&] (CompileJob& job) {
+        job.mPreprocessStart = std::filesystem::file_time_type::clock::now();
+        auto process = std::make_shared<SubProcess>();
+        if (!process->create(job.mPreprocessCommand, SubProcessFlags::RedirectOutput)) {
+            compile(job);
+            return;
+        }
+        job.mHash = HashBytes(job.mCache->mCompilerIdentity + '\0' + job.mFlags + '\0');
+
+        poller.add(process, [&job] (SubProcessStream stream, std::string_view text) {
+            if (stream == SubProcessStream::Output) {
+                job.mHash = HashBytes(text, job.mHash);
+                job.mPreprocessedSize += text.size();
+            }
+        }, [&] (int exitCode) {
+            if (exitCode == 0 && RecordInputs(job)) {
+                job.mCacheEntry = job.mCache->mDirectory / std::format("{:016x}-{:x}.o", job.mHash, job.mPreprocessedSize);
+            }
+            if (RestoreFromCache(job)) {
+                finish(job);
+            } else {
+                compile(job);
+            }
+        });
+    };
+
+    while (done < jobs.size()) {
+        while (running < jobCount && next < jobs.size()) {
+            CompileJob& job = jobs[next++];
+            running++;
+            if (job.mCache) {
+                preprocess(job);
+            } else {
+                compile(job);
+            }
+        }
+        poller.poll(std::chrono::milliseconds(-1));
+    }
+
+    return std::all_of(jobs.begin(), jobs.end(), [] (const CompileJob& job) { return job.mExitCode == 0; });
+}
+
+// Reads the prerequisites of the make rule written by -MMD -MF, the source file and its headers.
+static bool ReadDepFile(const std::filesystem::path& path, std::vector<std::filesystem::path>& deps) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file) {
+        return false;
+    }
+    std::string text((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+    // The target ends at the first colon followed by a blank, drive letters are left alone
+    size_t start = std::string::npos;
+    for (size_t i = 0; i < text.size(); i++) {
+        if (text[i] == ':' && (i + 1 == text.size() || std::isspace((unsigned char)text[i + 1]))) {
+            start = i + 1;
+            break;
+        }
+    }
+    if (start == std::string::npos) {
+        return false;
+    }
+
+    std::string dep;
+    for (size_t i = start; i < text.size(); i++) {
+        char c = text[i];
+        char next = i + 1 < text.size() ? text[i + 1] : '\0';
+
+        if (c == '\\' && (next == ' ' || next == '#')) {
+            dep += next;
+            i++;
+            continue;
+        }
+        if (c == '$' && next == '$') {
+            dep += '$';
+            i++;
+            continue;
+        }
+
+        bool continuation = c == '\\' && (next == '\n' || next == '\r');
+        if (!continuation && !std::isspace((unsigned char)c)) {
+            dep += c;
+            continue;
+        }
+
+        if (!dep.empty()) {
+            deps.emplace_back(dep);
+            dep.clear();
+        }
+        if (continuation) {
+            i += (next == '\r' && i + 2 < text.size() && text[i + 2] == '\n') ? 2 : 1;
+        } else if (c == '\n') {
+            break;
+        }
+    }
+    if (!dep.empty()) {
+        deps.emplace_back(dep);
+    }
+    return !deps.empty();
+}
+
+// Every output gets a stamp file holding the command that produced it,
+// so changing compiler or linker flags rebuilds it as well.
+static std::filesystem::path GetStampPath(const std::filesystem::path& output) {
+    std::filesystem::path stamp = output;
+    stamp += ".cmd";
+    return stamp;
+}
+
+static bool IsStampCurrent(const std::filesystem::path& output, const std::string& command) {
+    std::ifstream file(GetStampPath(output), std::ios::binary);
+    if (!file) {
+        return false;
+    }
+    std::string stamp((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    return stamp == command;
+}
+
+static void UpdateStamp(const std::filesystem::path& output, const std::string& command, bool success) {
+    std::error_code ec;
+    if (!success) {
+        std::filesystem::remove(GetStampPath(output), ec);
+        return;
+    }
+    std::ofstream file(GetStampPath(output), std::ios::binary | std::ios::trunc);
+    file << command;
+}
+
+// An object is up to date when it was built by the same command and is not older
+// than its source or any of the headers listed in its depfile.
+static bool IsObjectUpToDate(const CompileJob& job) {
+    std::error_code ec;
+    auto objectTime = std::filesystem::last_write_time(job.mObject, ec);
+    if (ec || !IsStampCurrent(job.mObject, job.mCommand)) {
+        return false;
+    }
+
+    std::vector<std::filesystem::path> deps;
+    if (!ReadDepFile(job.mDepFile, deps)) {
+        return false;
+    }
+    for (const auto& dep : deps) {
+        auto depTime = std::filesystem::last_write_time(dep, ec);
+        if (ec || depTime > objectTime) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool IsTargetNewer(const std::filesystem::path& target, const std::vector<std::filesystem::path>& objects) {
+    std::error_code ec;
+    auto targetTime = std::filesystem::last_write_time(target, ec);
+    if (ec) {
+        return false;
+    }
+    for (const auto& object : objects) {
+        auto objectTime = std::filesystem::last_write_time(object, ec);
+        if (ec || objectTime > targetTime) {
+            return false;
+        }
+    }
+    return true;
+}
+
 bool PaperCode::isProjectRunning() const {
     return mChildProcess && mChildProcess->isAlive();//mExecutionStatus == ExecutionStatus::Running;
 }
@@ -26,9 +379,11 @@ void PaperCode::runProject() {
         return;
     }
 
-    mChildProcess = std::make_shared<SubProcess>();
+    // The thread keeps its own reference, mChildProcess is replaced by the next run
+    auto process = std::make_shared<SubProcess>();
+    mChildProcess = process;
 
-    mRunThread = std::jthread([this, mProject] () {
+    mRunThread = std::jthread([this, mProject, process] () {
 
         UISystem& mUISystem = getUI();
 
@@ -52,27 +407,16 @@ void PaperCode::runProject() {
         mUISystem.clearBuildLogs();
         mUISystem.appendBuildLog("Executing: " + cmd + "\r\n");
 
-        if (!mChildProcess->create(cmd, SubProcessFlags::CreateConsole)) {
+        if (!process->create(cmd, SubProcessFlags::CreateConsole)) {
             mUISystem.appendBuildLog(std::format("Failed to execute command '{}'\r\n", cmd), LogType::Error);
         } else {
-            
-            while(1) {
-                int exitCode;
-                if (mChildProcess->getExitCode(&exitCode)) {
-                    if (!mChildProcess->isAlive()) {
-                        mUISystem.appendBuildLog(std::format("Process terminated with status {} (0 seconds(s))\r\n", exitCode), LogType::Info);
-                        break;
-                    }
-                } else {
-                    mUISystem.appendBuildLog(std::format("Failed to get exit code\r\n"), LogType::Error);
-                    break;
-                }
-            }
-
-            mChildProcess->terminate();
+            int exitCode = process->wait();
+            mUISystem.appendBuildLog(std::format("Process terminated with status {} ({:.2f} second(s))\r\n", 
+                exitCode, ToSeconds(process->getElapsedTime())), LogType::Info);
         }
 
         mExecutionStatus = ExecutionStatus::None;
+        mUISystem.wakeUp();
     });
 }
 
@@ -84,7 +428,7 @@ bool CompileProjectFiles(ProjectPtr proj) {
     return true;
 }
 
-void PaperCode::buildProject() {
+void PaperCode::buildProject(bool rebuildAll) {
 
     ProjectPtr mProject = getActiveProject();
 
@@ -158,7 +502,7 @@ void PaperCode::buildProject() {
     std::filesystem::current_path(old);
 
     std::cout << "LOG: Starting build thread..." << std::endl;
-    mBuildThread = std::jthread([this, mProject, objAbsolutePath, binAbsolutePath] () {
+    mBuildThread = std::jthread([this, mProject, objAbsolutePath, binAbsolutePath, rebuildAll] () {
 
         UISystem& mUISystem = getUI();
 
@@ -172,10 +516,25 @@ void PaperCode::buildProject() {
         //CompileProjectFiles(mProject);
         const BuildOption& buildOption = mProject->mDesc.mBuildOption;
 
-        bool compileSuccess = true;
-
         bool debugBuild = true;
 
+        // The compiler's version output tells builds by different compilers apart
+        CompileCache cache;
+        cache.mDirectory = objAbsolutePath / "cache";
+        cache.mLookup = !rebuildAll;
+        cache.mCompilerIdentity = mCompiler.mCompiler + "\n";
+
+        int versionExitCode;
+        std::error_code ec;
+        bool useCache = RunProcess(mCompiler.mCompiler + " --version", cache.mCompilerIdentity, versionExitCode) && versionExitCode == 0;
+        useCache = useCache && (std::filesystem::create_directories(cache.mDirectory, ec) || std::filesystem::is_directory(cache.mDirectory, ec));
+        if (!useCache) {
+            mUISystem.appendBuildLog("Compile cache unavailable, compiling everything.\r\n", LogType::Warning);
+        }
+
+        std::vector<CompileJob> jobs;
+        size_t upToDate = 0;
+
         for (ProjectFilePtr file : mProject->mFileList) {
 
             if (!file->isCompile()) {
@@ -216,47 +575,72 @@ void PaperCode::buildProject() {
 
             compilerOptions += buildOption.mAdditionalCompileFlags + " ";
 
-            std::string cmd = mCompiler.mCompiler + " " + 
+            CompileJob job;
+            job.mObject = objFile;
+            job.mDepFile = std::filesystem::path(objFile).replace_extension(".d");
+            job.mCommand = mCompiler.mCompiler + " " + 
                 compilerOptions + " " + 
                 " -c " + file->getAbsolutePath(mProject).string() +
-                " -o " + objFile.string();
+                " -o " + objFile.string() +
+                " -MMD -MF " + job.mDepFile.string();
+
+            if (useCache) {
+                job.mCache = &cache;
+                job.mFlags = compilerOptions;
+                job.mPreprocessCommand = mCompiler.mCompiler + " " + 
+                    compilerOptions + " " + 
+                    " -E " + file->getAbsolutePath(mProject).string() +
+                    " -MMD -MF " + job.mDepFile.string();
+            }
 
-            mUISystem.appendBuildLog(cmd);
-            mUISystem.appendBuildLog("\r\n\r\n");
+            if (!rebuildAll && IsObjectUpToDate(job)) {
+                upToDate++;
+                continue;
+            }
+            jobs.push_back(std::move(job));
+        }
 
-            mChildProcess = std::make_shared<SubProcess>();
+        if (upToDate > 0) {
+            mUISystem.appendBuildLog(std::format("{} of {} file(s) up to date.\r\n\r\n", upToDate, upToDate + jobs.size()), LogType::Info);
+        }
 
-            if (!mChildProcess->create(cmd, SubProcessFlags::RedirectOutput)) {
-                mUISystem.appendBuildLog(std::format("Failed to execute command '{}'\r\n", cmd), LogType::Error);
-                continue;
+        size_t cacheHits = 0;
+        size_t cacheMisses = 0;
+
+        unsigned jobCount = (unsigned)std::max(buildOption.mJobs, 0);
+        bool compileSuccess = RunCompileJobs(jobs, jobCount, [&] (CompileJob& job, size_t done) {
+            mUISystem.appendBuildLog(std::format("[{}/{}] {}\r\n\r\n", done, jobs.size(), job.mCommand));
+
+            if (!job.mStarted) {
+                mUISystem.appendBuildLog(std::format("Failed to execute command '{}'\r\n", job.mCommand), LogType::Error);
+                return;
             }
+            UpdateStamp(job.mObject, job.mCommand, job.mExitCode == 0);
 
-            mChildProcess->read([this](const std::string& line) {
-                 getUI().appendBuildLog(line);
-            });
-
-            while(1) {
-                int exitCode;
-                if (mChildProcess->getExitCode(&exitCode)) {
-                    if (!mChildProcess->isAlive()) {
-                        if (exitCode != 0) {
-                            compileSuccess = false;
-                        }
-                        mUISystem.appendBuildLog(std::format("Process terminated with status {} (0 seconds(s))\r\n", exitCode), LogType::Info);
-                        break;
-                    }
-                } else {
-                    mUISystem.appendBuildLog(std::format("Failed to get exit code\r\n"), LogType::Error);
-                    break;
+            if (job.mCacheHit) {
+                cacheHits++;
+                mUISystem.appendBuildLog("Restored from compile cache\r\n", LogType::Info);
+                if (!job.mOutput.empty()) {
+                    mUISystem.appendBuildLog(job.mOutput);
                 }
+                return;
+            }
+            if (job.mCache) {
+                cacheMisses++;
+            }
+            if (!job.mOutput.empty()) {
+                mUISystem.appendBuildLog(job.mOutput);
             }
+            mUISystem.appendBuildLog(std::format("Process terminated with status {} ({:.2f} second(s))\r\n", job.mExitCode, ToSeconds(job.mElapsed)), LogType::Info);
+        });
 
-            mChildProcess->terminate();
+        // Nothing is evicted, the size at least shows when the directory is worth clearing
+        if (cacheHits + cacheMisses > 0) {
+            mUISystem.appendBuildLog(std::format("Compile cache: {} hit(s), {} miss(es), {:.1f} MB in {}\r\n", cacheHits, cacheMisses,
+                GetDirectorySize(cache.mDirectory) / (1024.0 * 1024.0), cache.mDirectory.string()), LogType::Info);
         }
 
         if (compileSuccess) {
-            mUISystem.appendBuildLog("Linking...\r\n");
-
             bool buildSuccess = true;
             std::string outputFile = mProject->getBinWithFullPath().string();
 
@@ -266,6 +650,7 @@ void PaperCode::buildProject() {
                 cmd = std::format("{} {} crf {} ", mCompiler.mArchive, buildOption.mAdditionalLinkFlags, outputFile);
             }
 
+            std::vector<std::filesystem::path> objects;
             for (ProjectFilePtr file : mProject->mFileList) {
                 // If not compiled, then not linked
                 if (!file->isCompile()) {
@@ -275,42 +660,44 @@ void PaperCode::buildProject() {
                 objFile.append(file->getFileNameNoExt() + ".o");
 
                 cmd += objFile.string() + " ";
+                objects.push_back(objFile);
             }
 
             if (buildOption.mSubSystem == BuildSubSystem::GUI) {
                 cmd += "-Wl,--subsystem,windows ";
             }
 
+            // The link stamp lives with the objects rather than next to the binary
+            std::filesystem::path linkStamp = objAbsolutePath / std::filesystem::path(outputFile).filename();
+
+            if (!rebuildAll && jobs.empty() && IsTargetNewer(outputFile, objects) && IsStampCurrent(linkStamp, cmd)) {
+                mUISystem.appendBuildLog("Target is up to date.\r\n", LogType::Success);
+                mExecutionStatus = ExecutionStatus::None;
+                mUISystem.wakeUp();
+                return;
+            }
+
+            mUISystem.appendBuildLog("Linking...\r\n");
+
             mUISystem.appendBuildLog(cmd);
             mUISystem.appendBuildLog("\r\n");
 
-            // Reinitialize the process object for the linking step-
-            // TODO: There should be a better/proper way?
-            mChildProcess = std::make_shared<SubProcess>();
+            // mChildProcess belongs to the running program, the linker gets a process of its own
+            SubProcess linker;
 
-            if (mChildProcess->create(cmd, SubProcessFlags::RedirectOutput)) {
-                mChildProcess->read([this](const std::string& line) {
+            if (linker.create(cmd, SubProcessFlags::RedirectOutput)) {
+                linker.read([this](const std::string& line) {
                      getUI().appendBuildLog(line);
                 });
 
-                while(1) {
-                    int exitCode;
-                    if (mChildProcess->getExitCode(&exitCode)) {
-                        if (!mChildProcess->isAlive()) {
-                            if (exitCode != 0) {
-                                buildSuccess = false;
-                            }
-                            mUISystem.appendBuildLog(std::format("Process terminated with status {} (0 seconds(s))\r\n", exitCode), LogType::Info);
-                            break;
-                        }
-                    } else {
-                        mUISystem.appendBuildLog(std::format("Failed to get exit code\r\n"), LogType::Error);
-                        break;
-                    }
+                int exitCode = linker.wait();
+                if (exitCode != 0) {
+                    buildSuccess = false;
                 }
+                mUISystem.appendBuildLog(std::format("Process terminated with status {} ({:.2f} second(s))\r\n", 
+                    exitCode, ToSeconds(linker.getElapsedTime())), LogType::Info);
 
-                mChildProcess->terminate();
-
+                UpdateStamp(linkStamp, cmd, buildSuccess);
                 if (buildSuccess) {
                     mUISystem.appendBuildLog("Build successfuly.\r\n", LogType::Success);
                 }
@@ -322,6 +709,7 @@ void PaperCode::buildProject() {
         }
 
         mExecutionStatus = ExecutionStatus::None;
+        mUISystem.wakeUp();
     });
 }
 
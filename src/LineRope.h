@@ -0,0 +1,432 @@
+#pragma once
+
+#include <vector>
+#include <iterator>
+#include <utility>
+#include <cassert>
+#include <algorithm>
+#include <functional>
+
+// A sequence of text lines stored as a shallow rope: the lines are kept in blocks of at
+// most kMaxBlockLines entries and a Fenwick tree over the block sizes maps a line number
+// to its block in O(log n). Inserting or removing lines therefore only shifts the lines of
+// a single block instead of the whole document, no matter how large the file is.
+// Blocks can also be added unloaded (assign_lazy) and are then filled on first access.
+template<class T>
+class LineRope
+{
+public:
+	static constexpr int kMaxBlockLines = 512;
+	static constexpr int kMinBlockLines = kMaxBlockLines / 8;
+
+	template<bool Const>
+	class Iterator
+	{
+	public:
+		using iterator_category = std::forward_iterator_tag;
+		using value_type = T;
+		using difference_type = std::ptrdiff_t;
+		using pointer = std::conditional_t<Const, const T*, T*>;
+		using reference = std::conditional_t<Const, const T&, T&>;
+		using RopePtr = std::conditional_t<Const, const LineRope*, LineRope*>;
+
+		Iterator() : mRope(nullptr), mBlock(0), mOffset(0) {}
+		Iterator(RopePtr aRope, size_t aBlock, size_t aOffset) : mRope(aRope), mBlock(aBlock), mOffset(aOffset) {}
+
+		reference operator*() const { return mRope->LoadedBlock(mBlock)[mOffset]; }
+		pointer operator->() const { return &mRope->LoadedBlock(mBlock)[mOffset]; }
+
+		Iterator& operator++()
+		{
+			if (++mOffset >= mRope->BlockSize(mBlock))
+			{
+				++mBlock;
+				mOffset = 0;
+			}
+			return *this;
+		}
+
+		Iterator operator++(int) { auto tmp = *this; ++(*this); return tmp; }
+
+		bool operator==(const Iterator& o) const { return mBlock == o.mBlock && mOffset == o.mOffset; }
+		bool operator!=(const Iterator& o) const { return !(*this == o); }
+
+	private:
+		RopePtr mRope;
+		size_t mBlock;
+		size_t mOffset;
+	};
+
+	using iterator = Iterator<false>;
+	using const_iterator = Iterator<true>;
+
+	// Fills an unloaded block with aCount lines, aKey is the value given to assign_lazy()
+	typedef std::function<void(size_t aKey, int aCount, std::vector<T>& aLines)> BlockLoader;
+
+	LineRope() : mSize(0), mTopBit(0), mIndexDirty(false), mCacheBlock(-1), mCacheStart(0) {}
+
+	int size() const { return mSize; }
+	bool empty() const { return mSize == 0; }
+
+	iterator begin() { return iterator(this, 0, 0); }
+	iterator end() { return iterator(this, mBlocks.size(), 0); }
+	const_iterator begin() const { return const_iterator(this, 0, 0); }
+	const_iterator end() const { return const_iterator(this, mBlocks.size(), 0); }
+
+	T& operator[](int aIndex)
+	{
+		int offset;
+		auto block = Locate(aIndex, offset);
+		return LoadedBlock(block)[offset];
+	}
+
+	const T& operator[](int aIndex) const
+	{
+		int offset;
+		auto block = Locate(aIndex, offset);
+		return LoadedBlock(block)[offset];
+	}
+
+	T& at(int aIndex) { return (*this)[aIndex]; }
+	const T& at(int aIndex) const { return (*this)[aIndex]; }
+
+	T& front() { assert(!empty()); return LoadedBlock(0).front(); }
+	T& back() { assert(!empty()); return LoadedBlock((int)mBlocks.size() - 1).back(); }
+	const T& front() const { assert(!empty()); return LoadedBlock(0).front(); }
+	const T& back() const { assert(!empty()); return LoadedBlock((int)mBlocks.size() - 1).back(); }
+
+	void clear()
+	{
+		mBlocks.clear();
+		mLazy.clear();
+		mLoader = nullptr;
+		mTree.clear();
+		mSize = 0;
+		mTopBit = 0;
+		mIndexDirty = false;
+		mCacheBlock = -1;
+	}
+
+	// Replaces the content with unloaded blocks, aBlocks holds the key and line count of each
+	// one. aLoader is called the first time a line of a block is accessed.
+	void assign_lazy(const std::vector<std::pair<size_t, int>>& aBlocks, BlockLoader aLoader)
+	{
+		clear();
+		mLoader = std::move(aLoader);
+		mBlocks.resize(aBlocks.size());
+		for (auto& [key, count] : aBlocks)
+		{
+			assert(count > 0 && count <= kMaxBlockLines);
+			mLazy.push_back({ key, count });
+			mSize += count;
+		}
+		mIndexDirty = true;
+	}
+
+	void push_back(T&& aLine)
+	{
+		if (mBlocks.empty() || BlockSize((int)mBlocks.size() - 1) >= kMaxBlockLines)
+		{
+			AddBlock((int)mBlocks.size());
+			mBlocks.back().reserve(kMaxBlockLines);
+		}
+		LoadedBlock((int)mBlocks.size() - 1).push_back(std::move(aLine));
+		++mSize;
+		Update((int)mBlocks.size() - 1, 1);
+	}
+
+	void push_back(const T& aLine) { push_back(T(aLine)); }
+
+	template<class... Args>
+	T& emplace_back(Args&&... aArgs)
+	{
+		push_back(T(std::forward<Args>(aArgs)...));
+		return back();
+	}
+
+	// Inserts a line before aIndex (aIndex == size() appends) and returns it
+	T& insert(int aIndex, T&& aLine)
+	{
+		assert(aIndex >= 0 && aIndex <= mSize);
+
+		if (aIndex == mSize)
+		{
+			push_back(std::move(aLine));
+			return back();
+		}
+
+		int offset;
+		auto block = Locate(aIndex, offset);
+		auto& lines = LoadedBlock(block);
+		lines.insert(lines.begin() + offset, std::move(aLine));
+		++mSize;
+		Update(block, 1);
+
+		if ((int)lines.size() > kMaxBlockLines)
+			SplitBlock(block);
+
+		return (*this)[aIndex];
+	}
+
+	// Inserts the lines [aFirst, aLast) before aIndex, moving them out of the source range
+	template<class It>
+	void insert(int aIndex, It aFirst, It aLast)
+	{
+		assert(aIndex >= 0 && aIndex <= mSize);
+
+		auto count = (int)std::distance(aFirst, aLast);
+		if (count == 0)
+			return;
+
+		if (mBlocks.empty())
+			AddBlock(0);
+
+		int block, offset;
+		if (aIndex == mSize)
+		{
+			block = (int)mBlocks.size() - 1;
+			offset = BlockSize(block);
+		}
+		else
+			block = Locate(aIndex, offset);
+
+		auto& lines = LoadedBlock(block);
+		lines.insert(lines.begin() + offset, std::make_move_iterator(aFirst), std::make_move_iterator(aLast));
+		mSize += count;
+		Update(block, count);
+
+		if ((int)lines.size() > kMaxBlockLines)
+			SplitBlock(block);
+	}
+
+	// Removes the lines [aFrom, aTo)
+	void erase(int aFrom, int aTo)
+	{
+		assert(aFrom >= 0 && aFrom <= aTo && aTo <= mSize);
+
+		// At most two blocks are cut partially, the one holding aFrom and the one holding aTo
+		auto count = aTo - aFrom;
+		int firstPartial = -1;
+		int lastPartial = -1;
+		while (count > 0)
+		{
+			int offset;
+			int block = Locate(aFrom, offset);
+
+			// whole blocks are dropped without loading them
+			auto size = BlockSize(block);
+			if (offset == 0 && count >= size)
+			{
+				RemoveBlocks(block, 1);
+				mSize -= size;
+				count -= size;
+				continue;
+			}
+
+			auto& lines = LoadedBlock(block);
+			auto n = std::min(count, (int)lines.size() - offset);
+			lines.erase(lines.begin() + offset, lines.begin() + offset + n);
+			mSize -= n;
+			count -= n;
+			Update(block, -n);
+
+			if (firstPartial < 0)
+				firstPartial = block;
+			lastPartial = block;
+		}
+
+		// The later block first, merging it never moves the earlier one
+		if (lastPartial != firstPartial)
+			MergeSmallBlock(lastPartial);
+		if (firstPartial >= 0)
+			MergeSmallBlock(firstPartial);
+	}
+
+	void erase(int aIndex) { erase(aIndex, aIndex + 1); }
+
+private:
+	struct LazyBlock
+	{
+		size_t mKey;
+		int mCount;		// 0 once loaded
+	};
+
+	bool IsLoaded(int aBlock) const { return mLazy.empty() || mLazy[aBlock].mCount == 0; }
+
+	int BlockSize(int aBlock) const { return IsLoaded(aBlock) ? (int)mBlocks[aBlock].size() : mLazy[aBlock].mCount; }
+
+	std::vector<T>& LoadedBlock(int aBlock) const
+	{
+		if (!IsLoaded(aBlock))
+		{
+			auto& lazy = mLazy[aBlock];
+			auto& lines = mBlocks[aBlock];
+			lines.reserve(kMaxBlockLines);
+			mLoader(lazy.mKey, lazy.mCount, lines);
+			assert((int)lines.size() == lazy.mCount);
+			lines.resize(lazy.mCount);
+			lazy.mCount = 0;
+		}
+		return mBlocks[aBlock];
+	}
+
+	void AddBlock(int aBlock)
+	{
+		mBlocks.emplace(mBlocks.begin() + aBlock);
+		if (!mLazy.empty())
+			mLazy.insert(mLazy.begin() + aBlock, { 0, 0 });
+		mIndexDirty = true;
+		mCacheBlock = -1;
+	}
+
+	void RemoveBlocks(int aBlock, int aCount)
+	{
+		mBlocks.erase(mBlocks.begin() + aBlock, mBlocks.begin() + aBlock + aCount);
+		if (!mLazy.empty())
+			mLazy.erase(mLazy.begin() + aBlock, mLazy.begin() + aBlock + aCount);
+		mIndexDirty = true;
+		mCacheBlock = -1;
+	}
+
+	// Finds the block holding line aIndex and the line offset within it
+	int Locate(int aIndex, int& aOffset) const
+	{
+		assert(aIndex >= 0 && aIndex < mSize);
+
+		if (mIndexDirty)
+			RebuildIndex();
+
+		// Most accesses walk the document sequentially, so try the cached block and its successor first
+		if (mCacheBlock >= 0)
+		{
+			if (aIndex >= mCacheStart && aIndex < mCacheStart + BlockSize(mCacheBlock))
+			{
+				aOffset = aIndex - mCacheStart;
+				return mCacheBlock;
+			}
+			auto next = mCacheBlock + 1;
+			auto nextStart = mCacheStart + BlockSize(mCacheBlock);
+			if (next < (int)mBlocks.size() && aIndex >= nextStart && aIndex < nextStart + BlockSize(next))
+			{
+				mCacheBlock = next;
+				mCacheStart = nextStart;
+				aOffset = aIndex - nextStart;
+				return next;
+			}
+		}
+
+		// Fenwick tree descent: find the number of whole blocks before aIndex
+		int pos = 0;
+		int remaining = aIndex;
+		for (int step = mTopBit; step > 0; step >>= 1)
+		{
+			if (pos + step < (int)mTree.size() && mTree[pos + step] <= remaining)
+			{
+				pos += step;
+				remaining -= mTree[pos];
+			}
+		}
+
+		mCacheBlock = pos;
+		mCacheStart = aIndex - remaining;
+		aOffset = remaining;
+		return pos;
+	}
+
+	void Update(int aBlock, int aDelta)
+	{
+		if (mIndexDirty)
+			return;
+
+		for (int i = aBlock + 1; i < (int)mTree.size(); i += i & -i)
+			mTree[i] += aDelta;
+
+		if (mCacheBlock > aBlock)
+			mCacheBlock = -1;
+	}
+
+	void RebuildIndex() const
+	{
+		auto count = (int)mBlocks.size();
+		mTree.assign(count + 1, 0);
+		for (int i = 1; i <= count; ++i)
+		{
+			mTree[i] += BlockSize(i - 1);
+			auto parent = i + (i & -i);
+			if (parent <= count)
+				mTree[parent] += mTree[i];
+		}
+
+		mTopBit = 1;
+		while (mTopBit * 2 <= count)
+			mTopBit *= 2;
+		if (count == 0)
+			mTopBit = 0;
+
+		mIndexDirty = false;
+		mCacheBlock = -1;
+	}
+
+	// Splits an oversized block into half-full blocks
+	void SplitBlock(int aBlock)
+	{
+		auto lines = std::move(mBlocks[aBlock]);
+		auto total = (int)lines.size();
+		auto pieceSize = kMaxBlockLines / 2;
+		auto pieces = (total + pieceSize - 1) / pieceSize;
+
+		std::vector<std::vector<T>> split(pieces);
+		for (int i = 0; i < pieces; ++i)
+		{
+			auto first = lines.begin() + i * pieceSize;
+			auto last = lines.begin() + std::min(total, (i + 1) * pieceSize);
+			split[i].reserve(kMaxBlockLines);
+			split[i].insert(split[i].end(), std::make_move_iterator(first), std::make_move_iterator(last));
+		}
+
+		mBlocks.erase(mBlocks.begin() + aBlock);
+		mBlocks.insert(mBlocks.begin() + aBlock, std::make_move_iterator(split.begin()), std::make_move_iterator(split.end()));
+		if (!mLazy.empty())
+			mLazy.insert(mLazy.begin() + aBlock, pieces - 1, { 0, 0 });
+		mIndexDirty = true;
+		mCacheBlock = -1;
+	}
+
+	// Folds a block that got too small into one of its neighbours to keep the block count bounded
+	void MergeSmallBlock(int aBlock)
+	{
+		auto size = BlockSize(aBlock);
+		if (size >= kMinBlockLines)
+			return;
+
+		auto other = -1;
+		if (aBlock + 1 < (int)mBlocks.size() && size + BlockSize(aBlock + 1) <= kMaxBlockLines)
+			other = aBlock + 1;
+		else if (aBlock > 0 && size + BlockSize(aBlock - 1) <= kMaxBlockLines)
+			other = aBlock - 1;
+
+		if (other < 0)
+			return;
+
+		auto first = std::min(aBlock, other);
+		auto& dst = LoadedBlock(first);
+		auto& src = LoadedBlock(first + 1);
+		dst.insert(dst.end(), std::make_move_iterator(src.begin()), std::make_move_iterator(src.end()));
+		RemoveBlocks(first + 1, 1);
+	}
+
+	// Loading a lazy block does not change the sequence, so it is allowed from const accessors
+	mutable std::vector<std::vector<T>> mBlocks;
+	mutable std::vector<LazyBlock> mLazy;		// parallel to mBlocks, empty unless assign_lazy() was used
+	BlockLoader mLoader;
+	int mSize;
+
+	// Fenwick tree over block sizes (1-based), rebuilt lazily after blocks are split, merged or removed
+	mutable std::vector<int> mTree;
+	mutable int mTopBit;
+	mutable bool mIndexDirty;
+
+	// Last block found by Locate(), speeds up sequential access
+	mutable int mCacheBlock;
+	mutable int mCacheStart;
+};
@@ -155,6 +155,9 @@ void PaperCode::executeCommand(Commands cmd, CommandData data) {
     case Commands::Build:
         buildProject();
         break;
+    case Commands::Rebuild:
+        buildProject(true);
+        break;
     case Commands::Run:
         runProject();
         break;
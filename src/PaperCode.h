@@ -42,6 +42,15 @@ public:
     std::shared_ptr<TextEditor> mImEditor = nullptr;
     bool mFirstLoaded = true;
     bool mFlagSelected = false;
+    // Opened read-only from a memory mapping, see UIEditor::openFile
+    bool mLargeFile = false;
+    // Text shared with SmartSense, rebuilt only when the editor's text version moves
+    std::shared_ptr<const std::string> mSnapshot = nullptr;
+    uint64_t mSnapshotTextVersion = 0;
+    uint64_t mSnapshotVersion = 0;
+    // Edited since the last snapshot was handed to SmartSense
+    bool mSnapshotPending = false;
+    std::chrono::steady_clock::time_point mLastEdit;
 public:
     UIEditor() { }
     ~UIEditor() { }
@@ -54,6 +63,12 @@ public:
 
     int getTabSize() const;
 
+    // Seconds until the editor needs a redraw without input, negative if it doesn't
+    float getRedrawDelay() const;
+
+    // Immutable copy of the current text, the version grows with every new copy
+    std::shared_ptr<const std::string> getSnapshot(uint64_t* version = nullptr);
+
     const std::filesystem::path& getFilePath() const { return mFilePath; }
     const std::string& getFileName() const { return mFileName; }
 
@@ -89,6 +104,9 @@ struct UIProjectProperties {
 };
 
 struct UIPreference {
+    // Edited here and only written to the settings by applyChanges
+    int mSmartSenseThreads = 0;
+    int mReparseDelay = 0;
 
     void open();
     void close();
@@ -162,6 +180,38 @@ struct UIMessageBox {
     void draw();
 };
 
+class SymbolSearch;
+struct SmartSense;
+
+// Workspace wide "go to symbol" over the symbols SmartSense found in the project
+struct UIQuickOpen {
+    bool mTriggerPopup = false;
+    std::shared_ptr<SymbolSearch> mSearch = nullptr;
+    // SmartSense and symbols version mSearch was built from, and when the last build started
+    const SmartSense* mSymbolsSource = nullptr;
+    uint64_t mSymbolsVersion = 0;
+    std::chrono::steady_clock::time_point mSymbolsBuilt;
+    // A build in progress on mBuildThread, for mBuildSource at mBuildVersion. The thread hands
+    // the new index over in mBuilt.
+    bool mBuilding = false;
+    const SmartSense* mBuildSource = nullptr;
+    uint64_t mBuildVersion = 0;
+    std::mutex mBuildMutex;
+    std::shared_ptr<SymbolSearch> mBuilt;
+    std::jthread mBuildThread;      // last, so it is joined before the members it uses go
+    char mPattern[256] = {};
+    std::string mSearchedPattern = "";
+    std::vector<uint32_t> mResults;
+    int mSelected = 0;
+    bool mFocusPattern = false;
+
+    void open();
+    void close();
+    void update(bool search = false);
+    void jumpTo(uint32_t symbol);
+    void draw();
+};
+
 enum class UINotification {
     None,
     ProjectFileAdded,
@@ -175,6 +225,10 @@ struct UINotificationData {
 };
 
 struct UIEditorManager {
+    // Typing pause after which the editor text is handed to SmartSense, so a burst of
+    // keystrokes costs one copy of the document instead of one per keystroke
+    static constexpr auto kSnapshotDelay = std::chrono::milliseconds(300);
+
     UIEditorList mEditors;
     UIEditorPtr mActiveEditor = nullptr;
     bool mShowEditors = false;
@@ -210,10 +264,14 @@ struct UISystem {
     UINewFile mNewFile;
     UIRenameFile mRenameFile;
     UIPreference mPreference;
+    UIQuickOpen mQuickOpen;
 
     //
     bool mShowStatus = true;
 
+    // Frames still drawn without waiting after the last event, see UISystem::waitEvents
+    int mActiveFrames = 0;
+
     LogSystem mBuildLogs;
 
     UISystem() = default;
@@ -248,6 +306,9 @@ struct UISystem {
     void drawToolbar();
 
     bool runEventLoop();
+    void waitEvents();
+    // Makes the event loop draw a frame, can be called from any thread
+    void wakeUp();
     void handleKeyboardInputs();
     void terminate();
 
@@ -274,6 +335,7 @@ enum class Commands {
     RemoveProjectFile,
     CompileCurrent,
     Build,
+    Rebuild,
     Run,
     Stop,
     StartDebug,
@@ -346,7 +408,7 @@ struct PaperCode {
     void saveProject();
     void saveAll();
 
-    void buildProject();
+    void buildProject(bool rebuildAll = false);
     void runProject();
     void stopProject();
 
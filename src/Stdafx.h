@@ -10,6 +10,8 @@
 #include <vector>
 #include <filesystem>
 #include <thread>
+#include <mutex>
+#include <chrono>
 #include <memory>
 #include <format>
 #include <functional>
@@ -10,6 +10,7 @@
 #include <imgui_internal.h>
 
 #include "TextEditor.h"
+#include "TextEditorScan.h"
 
 #define IMGUI_DEFINE_MATH_OPERATORS
 #include "imgui.h" // for imGui::GetCurrentWindow()
@@ -17,16 +18,12 @@
 // TODO 
 // - multiline comments vs single-line: latter is blocking start of a ML
 
-template<class InputIt1, class InputIt2, class BinaryPredicate>
-bool equals(InputIt1 first1, InputIt1 last1,
-	InputIt2 first2, InputIt2 last2, BinaryPredicate p)
+static void SetGlyphFlag(TextEditor::GlyphAttr& aAttr, TextEditor::GlyphAttr aFlag, bool aValue)
 {
-	for (; first1 != last1 && first2 != last2; ++first1, ++first2)
-	{
-		if (!p(*first1, *first2))
-			return false;
-	}
-	return first1 == last1 && first2 == last2;
+	if (aValue)
+		aAttr |= aFlag;
+	else
+		aAttr &= ~aFlag;
 }
 
 TextEditor::TextEditor()
@@ -47,13 +44,28 @@ TextEditor::TextEditor()
 	, mColorRangeMax(0)
 	, mSelectionMode(SelectionMode::Normal)
 	, mCheckComments(true)
+	, mCommentRangeMin(0)
+	, mCommentRangeMax(0)
+	, mTextVersion(0)
+	, mColorizeInFlight(false)
+	, mColorizeCleanHead(0)
+	, mColorizeCleanTail(0)
+	, mLayoutFont(nullptr)
+	, mLayoutFontSize(0.0f)
+	, mLayoutTabSize(0)
+	, mLayoutGeneration(0)
+	, mSpaceAdvance(0.0f)
 	, mLastClick(-1.0f)
 	, mHandleKeyboardInputs(true)
 	, mHandleMouseInputs(true)
 	, mIgnoreImGuiChild(false)
 	, mShowWhitespaces(true)
 	, mStartTime(std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count())
+	, mCursorBlinking(false)
+	, mColorizeBusy(false)
 {
+	mAsciiAdvance.fill(0.0f);
+	mAsciiGlyphs.fill(nullptr);
 	SetPalette(GetDarkPalette());
 	SetLanguageDefinition(LanguageDefinition::HLSL());
 	mLines.push_back(Line());
@@ -61,10 +73,17 @@ TextEditor::TextEditor()
 
 TextEditor::~TextEditor()
 {
+	if (mColorizeThread.joinable())
+	{
+		mColorizeThread.request_stop();
+		mColorizeThread.join();
+	}
 }
 
 void TextEditor::SetLanguageDefinition(const LanguageDefinition & aLanguageDef)
 {
+	CancelColorizeJob();
+
 	mLanguageDefinition = aLanguageDef;
 	mRegexList.clear();
 
@@ -94,22 +113,21 @@ std::string TextEditor::GetText(const Coordinates & aStart, const Coordinates &
 
 	result.reserve(s + s / 8);
 
-	while (istart < iend || lstart < lend)
+	for (; lstart <= lend && lstart < (int)mLines.size(); ++lstart, istart = 0)
 	{
-		if (lstart >= (int)mLines.size())
-			break;
-
+		// A truncated UTF-8 sequence at the end of a line puts the character index past the end
 		auto& line = mLines[lstart];
-		if (istart < (int)line.size())
+		istart = std::min(istart, (int)line.size());
+		if (lstart < lend)
 		{
-			result += line[istart].mChar;
-			istart++;
+			result.append(line.mChars, istart, std::string::npos);
+			result += '\n';
 		}
 		else
 		{
-			istart = 0;
-			++lstart;
-			result += '\n';
+			iend = std::min(iend, (int)line.size());
+			if (istart < iend)
+				result.append(line.mChars, istart, iend - istart);
 		}
 	}
 
@@ -209,7 +227,7 @@ void TextEditor::Advance(Coordinates & aCoordinates) const
 
 		if (cindex + 1 < (int)line.size())
 		{
-			auto delta = UTF8CharLength(line[cindex].mChar);
+			auto delta = UTF8CharLength(line[cindex]);
 			cindex = std::min(cindex + delta, (int)line.size() - 1);
 		}
 		else
@@ -239,20 +257,20 @@ void TextEditor::DeleteRange(const Coordinates & aStart, const Coordinates & aEn
 		auto& line = mLines[aStart.mLine];
 		auto n = GetLineMaxColumn(aStart.mLine);
 		if (aEnd.mColumn >= n)
-			line.erase(line.begin() + start, line.end());
+			line.erase(start, line.size());
 		else
-			line.erase(line.begin() + start, line.begin() + end);
+			line.erase(start, end);
 	}
 	else
 	{
 		auto& firstLine = mLines[aStart.mLine];
 		auto& lastLine = mLines[aEnd.mLine];
 
-		firstLine.erase(firstLine.begin() + start, firstLine.end());
-		lastLine.erase(lastLine.begin(), lastLine.begin() + end);
+		firstLine.erase(start, firstLine.size());
+		lastLine.erase(0, end);
 
 		if (aStart.mLine < aEnd.mLine)
-			firstLine.insert(firstLine.end(), lastLine.begin(), lastLine.end());
+			firstLine.append(lastLine);
 
 		if (aStart.mLine < aEnd.mLine)
 			RemoveLine(aStart.mLine + 1, aEnd.mLine + 1);
@@ -264,49 +282,67 @@ void TextEditor::DeleteRange(const Coordinates & aStart, const Coordinates & aEn
 int TextEditor::InsertTextAt(Coordinates& /* inout */ aWhere, const char * aValue)
 {
 	assert(!mReadOnly);
+	assert(!mLines.empty());
 
-	int cindex = GetCharacterIndex(aWhere);
-	int totalLines = 0;
-	while (*aValue != '\0')
+	// Splits aValue into line segments, skipping carriage returns, so every segment
+	// is inserted with a single range insert instead of one glyph at a time
+	auto nextSegment = [](const char*& aText, Line& aOut) -> bool
 	{
-		assert(!mLines.empty());
-
-		if (*aValue == '\r')
+		while (*aText != '\0' && *aText != '\n')
 		{
-			// skip
-			++aValue;
+			if (*aText != '\r')
+				aOut.push_back(*aText);
+			++aText;
 		}
-		else if (*aValue == '\n')
+		if (*aText == '\n')
 		{
-			if (cindex < (int)mLines[aWhere.mLine].size())
-			{
-				auto& newLine = InsertLine(aWhere.mLine + 1);
-				auto& line = mLines[aWhere.mLine];
-				newLine.insert(newLine.begin(), line.begin() + cindex, line.end());
-				line.erase(line.begin() + cindex, line.end());
-			}
-			else
-			{
-				InsertLine(aWhere.mLine + 1);
-			}
-			++aWhere.mLine;
-			aWhere.mColumn = 0;
-			cindex = 0;
-			++totalLines;
-			++aValue;
+			++aText;
+			return true;
 		}
-		else
+		return false;
+	};
+
+	int cindex = GetCharacterIndex(aWhere);
+
+	Line segment;
+	auto hasNewLine = nextSegment(aValue, segment);
+
+	auto& line = mLines[aWhere.mLine];
+	if (!hasNewLine)
+	{
+		if (!segment.empty())
 		{
-			auto& line = mLines[aWhere.mLine];
-			auto d = UTF8CharLength(*aValue);
-			while (d-- > 0 && *aValue != '\0')
-				line.insert(line.begin() + cindex++, Glyph(*aValue++, PaletteIndex::Default));
-			++aWhere.mColumn;
+			line.insert(cindex, segment, 0, segment.size());
+			aWhere.mColumn = GetCharacterColumn(aWhere.mLine, cindex + (int)segment.size());
+			mTextChanged = true;
 		}
+		return 0;
+	}
 
-		mTextChanged = true;
+	// Move the remainder of the current line out, it goes at the end of the last inserted line
+	Line tail;
+	tail.insert(0, line, cindex, line.size());
+	line.erase(cindex, line.size());
+	line.append(segment);
+
+	std::vector<Line> newLines;
+	for (;;)
+	{
+		newLines.emplace_back();
+		if (!nextSegment(aValue, newLines.back()))
+			break;
 	}
 
+	auto lastLength = (int)newLines.back().size();
+	newLines.back().append(tail);
+
+	auto totalLines = (int)newLines.size();
+	InsertLines(aWhere.mLine + 1, newLines);
+
+	aWhere.mLine += totalLines;
+	aWhere.mColumn = GetCharacterColumn(aWhere.mLine, lastLength);
+	mTextChanged = true;
+
 	return totalLines;
 }
 
@@ -345,11 +381,10 @@ TextEditor::Coordinates TextEditor::ScreenPosToCoordinates(const ImVec2& aPositi
 		{
 			float columnWidth = 0.0f;
 
-			if (line[columnIndex].mChar == '\t')
+			if (line[columnIndex] == '\t')
 			{
-				float spaceSize = ImGui::GetFont()->CalcTextSizeA(ImGui::GetFontSize(), FLT_MAX, -1.0f, " ").x;
 				float oldX = columnX;
-				float newColumnX = (1.0f + std::floor((1.0f + columnX) / (float(mTabSize) * spaceSize))) * (float(mTabSize) * spaceSize);
+				float newColumnX = TabStop(columnX);
 				columnWidth = newColumnX - oldX;
 				if (mTextStart + columnX + columnWidth * 0.5f > local.x)
 					break;
@@ -359,15 +394,12 @@ TextEditor::Coordinates TextEditor::ScreenPosToCoordinates(const ImVec2& aPositi
 			}
 			else
 			{
-				char buf[7];
-				auto d = UTF8CharLength(line[columnIndex].mChar);
-				int i = 0;
-				while (i < 6 && d-- > 0)
-					buf[i++] = line[columnIndex++].mChar;
-				buf[i] = '\0';
-				columnWidth = ImGui::GetFont()->CalcTextSizeA(ImGui::GetFontSize(), FLT_MAX, -1.0f, buf).x;
+				auto text = line.mChars.data() + columnIndex;
+				auto d = std::min(UTF8CharLength(line[columnIndex]), (int)line.size() - columnIndex);
+				columnWidth = TextWidth(text, text + d);
 				if (mTextStart + columnX + columnWidth * 0.5f > local.x)
 					break;
+				columnIndex += d;
 				columnX += columnWidth;
 				columnCoord++;
 			}
@@ -396,7 +428,7 @@ TextEditor::Coordinates TextEditor::FindWordStart(const Coordinates & aFrom) con
 		return at;
 	}
 
-	auto rightChar = line[cindex].mChar;
+	auto rightChar = line[cindex];
 
 	if (!isalpha(rightChar)) {
 
@@ -404,14 +436,14 @@ TextEditor::Coordinates TextEditor::FindWordStart(const Coordinates & aFrom) con
 
 	//printf("start char %c\n", firstChar);
 
-	while (cindex > 0 && isspace(line[cindex].mChar))
+	while (cindex > 0 && isspace(line[cindex]))
 		--cindex;
 
-	auto cstart = (PaletteIndex)line[cindex].mColorIndex;
+	auto cstart = GetGlyphColorIndex(line.mAttrs[cindex]);
 
 	while (cindex > 0)
 	{
-		auto c = line[cindex].mChar;
+		auto c = line[cindex];
 
 		if ((c & 0xC0) != 0x80)	// not UTF code sequence 10xxxxxx
 		{
@@ -420,7 +452,7 @@ TextEditor::Coordinates TextEditor::FindWordStart(const Coordinates & aFrom) con
 				cindex++;
 				break;
 			}
-			if (cstart != (PaletteIndex)line[size_t(cindex - 1)].mColorIndex)
+			if (cstart != GetGlyphColorIndex(line.mAttrs[size_t(cindex - 1)]))
 				break;
 		}
 		--cindex;
@@ -440,14 +472,14 @@ TextEditor::Coordinates TextEditor::FindWordEnd(const Coordinates & aFrom) const
 	if (cindex >= (int)line.size())
 		return at;
 
-	auto cstart = (PaletteIndex)line[cindex].mColorIndex;
+	auto cstart = GetGlyphColorIndex(line.mAttrs[cindex]);
 
 	while (cindex < (int)line.size())
 	{
-		auto c = line[cindex].mChar;
+		auto c = line[cindex];
 		auto d = UTF8CharLength(c);
 
-		if (cstart != (PaletteIndex)line[cindex].mColorIndex)
+		if (cstart != GetGlyphColorIndex(line.mAttrs[cindex]))
 			break;
 
 		if (isspace(c)) {
@@ -471,7 +503,7 @@ TextEditor::Coordinates TextEditor::FindNextWord(const Coordinates & aFrom) cons
 	if (cindex < (int)mLines[at.mLine].size())
 	{
 		auto& line = mLines[at.mLine];
-		isword = isalnum(line[cindex].mChar);
+		isword = isalnum(line[cindex]);
 		skip = isword;
 	}
 
@@ -486,7 +518,7 @@ TextEditor::Coordinates TextEditor::FindNextWord(const Coordinates & aFrom) cons
 		auto& line = mLines[at.mLine];
 		if (cindex < (int)line.size())
 		{
-			isword = isalnum(line[cindex].mChar);
+			isword = isalnum(line[cindex]);
 
 			if (isword && !skip)
 				return Coordinates(at.mLine, GetCharacterColumn(at.mLine, cindex));
@@ -513,17 +545,8 @@ int TextEditor::GetCharacterIndex(const Coordinates& aCoordinates) const
 	if (aCoordinates.mLine >= mLines.size())
 		return -1;
 	auto& line = mLines[aCoordinates.mLine];
-	int c = 0;
-	int i = 0;
-	for (; i < line.size() && c < aCoordinates.mColumn;)
-	{
-		if (line[i].mChar == '\t')
-			c = (c / mTabSize) * mTabSize + mTabSize;
-		else
-			++c;
-		i += UTF8CharLength(line[i].mChar);
-	}
-	return i;
+	auto text = line.mChars.data();
+	return TextScan::IndexOfColumn(text, text + line.size(), aCoordinates.mColumn, mTabSize);
 }
 
 int TextEditor::GetCharacterColumn(int aLine, int aIndex) const
@@ -531,18 +554,8 @@ int TextEditor::GetCharacterColumn(int aLine, int aIndex) const
 	if (aLine >= mLines.size())
 		return 0;
 	auto& line = mLines[aLine];
-	int col = 0;
-	int i = 0;
-	while (i < aIndex && i < (int)line.size())
-	{
-		auto c = line[i].mChar;
-		i += UTF8CharLength(c);
-		if (c == '\t')
-			col = (col / mTabSize) * mTabSize + mTabSize;
-		else
-			col++;
-	}
-	return col;
+	auto text = line.mChars.data();
+	return TextScan::ColumnAt(text, text + std::clamp(aIndex, 0, (int)line.size()), mTabSize);
 }
 
 int TextEditor::GetLineCharacterCount(int aLine) const
@@ -550,10 +563,8 @@ int TextEditor::GetLineCharacterCount(int aLine) const
 	if (aLine >= mLines.size())
 		return 0;
 	auto& line = mLines[aLine];
-	int c = 0;
-	for (unsigned i = 0; i < line.size(); c++)
-		i += UTF8CharLength(line[i].mChar);
-	return c;
+	auto text = line.mChars.data();
+	return TextScan::CharacterCount(text, text + line.size());
 }
 
 int TextEditor::GetLineMaxColumn(int aLine) const
@@ -561,17 +572,8 @@ int TextEditor::GetLineMaxColumn(int aLine) const
 	if (aLine >= mLines.size())
 		return 0;
 	auto& line = mLines[aLine];
-	int col = 0;
-	for (unsigned i = 0; i < line.size(); )
-	{
-		auto c = line[i].mChar;
-		if (c == '\t')
-			col = (col / mTabSize) * mTabSize + mTabSize;
-		else
-			col++;
-		i += UTF8CharLength(c);
-	}
-	return col;
+	auto text = line.mChars.data();
+	return TextScan::ColumnAt(text, text + line.size(), mTabSize);
 }
 
 bool TextEditor::IsOnWordBoundary(const Coordinates & aAt) const
@@ -585,16 +587,16 @@ bool TextEditor::IsOnWordBoundary(const Coordinates & aAt) const
 		return true;
 
 	if (mColorizerEnabled)
-		return line[cindex].mColorIndex != line[size_t(cindex - 1)].mColorIndex;
+		return GetGlyphColorIndex(line.mAttrs[cindex]) != GetGlyphColorIndex(line.mAttrs[size_t(cindex - 1)]);
 
-	return isspace(line[cindex].mChar) != isspace(line[cindex - 1].mChar);
+	return isspace(line[cindex]) != isspace(line[cindex - 1]);
 }
 
 void TextEditor::RemoveLine(int aStart, int aEnd)
 {
 	assert(!mReadOnly);
 	assert(aEnd >= aStart);
-	assert(mLines.size() > (size_t)(aEnd - aStart));
+	assert(mLines.size() > aEnd - aStart);
 
 	ErrorMarkers etmp;
 	for (auto& i : mErrorMarkers)
@@ -615,7 +617,8 @@ void TextEditor::RemoveLine(int aStart, int aEnd)
 	}
 	mBreakpoints = std::move(btmp);
 
-	mLines.erase(mLines.begin() + aStart, mLines.begin() + aEnd);
+	mLines.erase(aStart, aEnd);
+	ShiftColorizeRanges(aStart, aStart - aEnd);
 	assert(!mLines.empty());
 
 	mTextChanged = true;
@@ -645,7 +648,8 @@ void TextEditor::RemoveLine(int aIndex)
 	}
 	mBreakpoints = std::move(btmp);
 
-	mLines.erase(mLines.begin() + aIndex);
+	mLines.erase(aIndex);
+	ShiftColorizeRanges(aIndex, -1);
 	assert(!mLines.empty());
 
 	mTextChanged = true;
@@ -655,7 +659,8 @@ TextEditor::Line& TextEditor::InsertLine(int aIndex)
 {
 	assert(!mReadOnly);
 
-	auto& result = *mLines.insert(mLines.begin() + aIndex, Line());
+	auto& result = mLines.insert(aIndex, Line());
+	ShiftColorizeRanges(aIndex, 1);
 
 	ErrorMarkers etmp;
 	for (auto& i : mErrorMarkers)
@@ -670,6 +675,63 @@ TextEditor::Line& TextEditor::InsertLine(int aIndex)
 	return result;
 }
 
+void TextEditor::InsertLines(int aIndex, std::vector<Line>& aLines)
+{
+	assert(!mReadOnly);
+
+	auto count = (int)aLines.size();
+	if (count == 0)
+		return;
+
+	mLines.insert(aIndex, aLines.begin(), aLines.end());
+	ShiftColorizeRanges(aIndex, count);
+
+	ErrorMarkers etmp;
+	for (auto& i : mErrorMarkers)
+		etmp.insert(ErrorMarkers::value_type(i.first >= aIndex ? i.first + count : i.first, i.second));
+	mErrorMarkers = std::move(etmp);
+
+	Breakpoints btmp;
+	for (auto i : mBreakpoints)
+		btmp.insert(i >= aIndex ? i + count : i);
+	mBreakpoints = std::move(btmp);
+}
+
+// Keeps the pending colorize ranges on the same text when aCount lines are inserted
+// at aIndex, or removed from it when aCount is negative
+void TextEditor::ShiftColorizeRanges(int aIndex, int aCount)
+{
+	auto shiftBound = [aIndex, aCount](int& aBound)
+	{
+		if (aCount > 0)
+		{
+			if (aBound > aIndex)
+				aBound += aCount;
+		}
+		else if (aBound >= aIndex - aCount)
+			aBound += aCount;
+		else if (aBound > aIndex)
+			aBound = aIndex;
+	};
+
+	auto shiftRange = [&](int& aMin, int& aMax)
+	{
+		if (aMin >= aMax)
+			return;
+
+		shiftBound(aMin);
+		shiftBound(aMax);
+		if (aMin >= aMax)
+		{
+			aMin = std::numeric_limits<int>::max();
+			aMax = 0;
+		}
+	};
+
+	shiftRange(mColorRangeMin, mColorRangeMax);
+	shiftRange(mCommentRangeMin, mCommentRangeMax);
+}
+
 std::string TextEditor::GetWordUnderCursor() const
 {
 	auto c = GetCursorPosition();
@@ -687,7 +749,7 @@ std::string TextEditor::GetWordAt(const Coordinates & aCoords) const
 	auto iend = GetCharacterIndex(end);
 
 	for (auto it = istart; it < iend; ++it) {
-		auto c = mLines[aCoords.mLine][it].mChar;
+		auto c = mLines[aCoords.mLine][it];
 		if (isalpha(c) || c== '_') {
 			r.push_back(c);
 		} else {
@@ -698,16 +760,16 @@ std::string TextEditor::GetWordAt(const Coordinates & aCoords) const
 	return r;
 }
 
-ImU32 TextEditor::GetGlyphColor(const Glyph & aGlyph) const
+ImU32 TextEditor::GetGlyphColor(GlyphAttr aAttr) const
 {
 	if (!mColorizerEnabled)
 		return mPalette[(int)PaletteIndex::Default];
-	if (aGlyph.mComment)
+	if (aAttr & GlyphComment)
 		return mPalette[(int)PaletteIndex::Comment];
-	if (aGlyph.mMultiLineComment)
+	if (aAttr & GlyphMultiLineComment)
 		return mPalette[(int)PaletteIndex::MultiLineComment];
-	auto const color = mPalette[(int)aGlyph.mColorIndex];
-	if (aGlyph.mPreprocessor)
+	auto const color = mPalette[(int)GetGlyphColorIndex(aAttr)];
+	if (aAttr & GlyphPreprocessor)
 	{
 		const auto ppcolor = mPalette[(int)PaletteIndex::Preprocessor];
 		const int c0 = ((ppcolor & 0xff) + (color & 0xff)) / 2;
@@ -920,7 +982,7 @@ void TextEditor::HandleMouseInputs()
 void TextEditor::Render()
 {
 	/* Compute mCharAdvance regarding to scaled font size (Ctrl + mouse wheel)*/
-	const float fontSize = ImGui::GetFont()->CalcTextSizeA(ImGui::GetFontSize(), FLT_MAX, -1.0f, "#", nullptr, nullptr).x;
+	const float fontSize = mAsciiAdvance['#'];
 	mCharAdvance = ImVec2(fontSize, ImGui::GetTextLineHeightWithSpacing() * mLineSpacing);
 
 	/* Update palette with the current alpha from style */
@@ -931,8 +993,6 @@ void TextEditor::Render()
 		mPalette[i] = ImGui::ColorConvertFloat4ToU32(color);
 	}
 
-	assert(mLineBuffer.empty());
-
 	auto contentSize = ImGui::GetWindowContentRegionMax();
 	auto drawList = ImGui::GetWindowDrawList();
 	float longest(mTextStart);
@@ -953,12 +1013,18 @@ void TextEditor::Render()
 
 	// Deduce mTextStart by evaluating mLines size (global lineMax) plus two spaces as text width
 	char buf[16];
-	snprintf(buf, 16, " %d ", globalLineMax);
-	mTextStart = ImGui::GetFont()->CalcTextSizeA(ImGui::GetFontSize(), FLT_MAX, -1.0f, buf, nullptr, nullptr).x + mLeftMargin;
+	auto bufLength = snprintf(buf, 16, " %d ", globalLineMax);
+	mTextStart = TextWidth(buf, buf + bufLength) + mLeftMargin;
 
 	if (!mLines.empty())
 	{
-		float spaceSize = ImGui::GetFont()->CalcTextSizeA(ImGui::GetFontSize(), FLT_MAX, -1.0f, " ", nullptr, nullptr).x;
+		auto font = ImGui::GetFont();
+		const float glyphScale = ImGui::GetFontSize() / font->FontSize;
+		const auto clipMin = drawList->GetClipRectMin();
+		const auto clipMax = drawList->GetClipRectMax();
+
+		// The glyph quads below sample the font atlas directly
+		drawList->PushTextureID(font->ContainerAtlas->TexID);
 
 		while (lineNo <= lineMax)
 		{
@@ -966,8 +1032,7 @@ void TextEditor::Render()
 			ImVec2 textScreenPos = ImVec2(lineStartScreenPos.x + mTextStart, lineStartScreenPos.y);
 
 			auto& line = mLines[lineNo];
-			longest = std::max(mTextStart + TextDistanceToLineStart(Coordinates(lineNo, GetLineMaxColumn(lineNo))), longest);
-			auto columnNo = 0;
+			longest = std::max(mTextStart + GetLineWidth(lineNo), longest);
 			Coordinates lineStartCoord(lineNo, 0);
 			Coordinates lineEndCoord(lineNo, GetLineMaxColumn(lineNo));
 
@@ -1022,9 +1087,9 @@ void TextEditor::Render()
 			}
 
 			// Draw line number (right aligned)
-			snprintf(buf, 16, "%d  ", lineNo + 1);
+			bufLength = snprintf(buf, 16, "%d  ", lineNo + 1);
 
-			auto lineNoWidth = ImGui::GetFont()->CalcTextSizeA(ImGui::GetFontSize(), FLT_MAX, -1.0f, buf, nullptr, nullptr).x;
+			auto lineNoWidth = TextWidth(buf, buf + bufLength);
 			drawList->AddText(ImVec2(lineStartScreenPos.x + mTextStart - lineNoWidth, lineStartScreenPos.y), mPalette[(int)PaletteIndex::LineNumber], buf);
 
 			if (mState.mCursorPosition.mLine == lineNo)
@@ -1042,6 +1107,7 @@ void TextEditor::Render()
 				// Render the cursor
 				if (focused)
 				{
+					mCursorBlinking = true;
 					auto timeEnd = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
 					auto elapsed = timeEnd - mStartTime;
 
@@ -1054,19 +1120,11 @@ void TextEditor::Render()
 
 						if (mOverwrite && cindex < (int)line.size())
 						{
-							auto c = line[cindex].mChar;
-							if (c == '\t')
-							{
-								auto x = (1.0f + std::floor((1.0f + cx) / (float(mTabSize) * spaceSize))) * (float(mTabSize) * spaceSize);
-								width = x - cx;
-							}
+							auto c = line.mChars.data() + cindex;
+							if (*c == '\t')
+								width = TabStop(cx) - cx;
 							else
-							{
-								char buf2[2];
-								buf2[0] = line[cindex].mChar;
-								buf2[1] = '\0';
-								width = ImGui::GetFont()->CalcTextSizeA(ImGui::GetFontSize(), FLT_MAX, -1.0f, buf2).x;
-							}
+								width = TextWidth(c, c + 1);
 						}
 						ImVec2 cstart(textScreenPos.x + cx, lineStartScreenPos.y);
 						ImVec2 cend(textScreenPos.x + cx + width, lineStartScreenPos.y + mCharAdvance.y);
@@ -1080,32 +1138,41 @@ void TextEditor::Render()
 			}
 
 			// Render colorized text
-			auto prevColor = line.empty() ? mPalette[(int)PaletteIndex::Default] : GetGlyphColor(line[0]);
+			// Glyph quads are written straight into the draw list. Space is reserved in bounded chunks
+			// so very long lines stay within the 16-bit index range, and the unused rest is given back
+			// before anything else (the whitespace markers) is drawn.
 			ImVec2 bufferOffset;
+			const char* text = line.mChars.data();
+			const auto size = (int)line.size();
+			const auto glyphY = std::floor(textScreenPos.y);
+			const int reserveGlyphs = 256;
+			auto reserved = 0;
 
-			for (int i = 0; i < line.size();)
+			auto unreserve = [&]()
 			{
-				auto& glyph = line[i];
-				auto color = GetGlyphColor(glyph);
+				if (reserved > 0)
+					drawList->PrimUnreserve(reserved * 6, reserved * 4);
+				reserved = 0;
+			};
 
-				if ((color != prevColor || glyph.mChar == '\t' || glyph.mChar == ' ') && !mLineBuffer.empty())
-				{
-					const ImVec2 newOffset(textScreenPos.x + bufferOffset.x, textScreenPos.y + bufferOffset.y);
-					drawList->AddText(newOffset, prevColor, mLineBuffer.c_str());
-					auto textSize = ImGui::GetFont()->CalcTextSizeA(ImGui::GetFontSize(), FLT_MAX, -1.0f, mLineBuffer.c_str(), nullptr, nullptr);
-					bufferOffset.x += textSize.x;
-					mLineBuffer.clear();
-				}
-				prevColor = color;
+			for (int i = 0; i < size;)
+			{
+				auto c = line[i];
+				auto glyphX = std::floor(textScreenPos.x + bufferOffset.x);
 
-				if (glyph.mChar == '\t')
+				// nothing further right can be visible
+				if (glyphX > clipMax.x)
+					break;
+
+				if (c == '\t')
 				{
 					auto oldX = bufferOffset.x;
-					bufferOffset.x = (1.0f + std::floor((1.0f + bufferOffset.x) / (float(mTabSize) * spaceSize))) * (float(mTabSize) * spaceSize);
+					bufferOffset.x = TabStop(bufferOffset.x);
 					++i;
 
 					if (mShowWhitespaces)
 					{
+						unreserve();
 						const auto s = ImGui::GetFontSize();
 						const auto x1 = textScreenPos.x + oldX + 1.0f;
 						const auto x2 = textScreenPos.x + bufferOffset.x - 1.0f;
@@ -1119,36 +1186,60 @@ void TextEditor::Render()
 						drawList->AddLine(p2, p4, 0x90909090);
 					}
 				}
-				else if (glyph.mChar == ' ')
+				else if (c == ' ')
 				{
 					if (mShowWhitespaces)
 					{
+						unreserve();
 						const auto s = ImGui::GetFontSize();
-						const auto x = textScreenPos.x + bufferOffset.x + spaceSize * 0.5f;
+						const auto x = textScreenPos.x + bufferOffset.x + mSpaceAdvance * 0.5f;
 						const auto y = textScreenPos.y + bufferOffset.y + s * 0.5f;
 						drawList->AddCircleFilled(ImVec2(x, y), 1.5f, 0x80808080, 4);
 					}
-					bufferOffset.x += spaceSize;
-					i++;
+					bufferOffset.x += mSpaceAdvance;
+					++i;
 				}
 				else
 				{
-					auto l = UTF8CharLength(glyph.mChar);
-					while (l-- > 0)
-						mLineBuffer.push_back(line[i++].mChar);
+					const ImFontGlyph* glyph;
+					int length = 1;
+					if (c < 0x80)
+						glyph = mAsciiGlyphs[c];
+					else
+					{
+						unsigned int codepoint;
+						length = std::max(1, ImTextCharFromUtf8(&codepoint, text + i, text + size));
+						glyph = font->FindGlyph((ImWchar)codepoint);
+					}
+
+					if (glyph != nullptr)
+					{
+						if (glyph->Visible && glyphX + glyph->X1 * glyphScale >= clipMin.x)
+						{
+							if (reserved == 0)
+							{
+								reserved = std::min(size - i, reserveGlyphs);
+								drawList->PrimReserve(reserved * 6, reserved * 4);
+							}
+							drawList->PrimRectUV(
+								ImVec2(glyphX + glyph->X0 * glyphScale, glyphY + glyph->Y0 * glyphScale),
+								ImVec2(glyphX + glyph->X1 * glyphScale, glyphY + glyph->Y1 * glyphScale),
+								ImVec2(glyph->U0, glyph->V0), ImVec2(glyph->U1, glyph->V1),
+								GetGlyphColor(line.mAttrs[i]));
+							--reserved;
+						}
+						bufferOffset.x += glyph->AdvanceX * glyphScale;
+					}
+					i = std::min(i + length, size);
 				}
-				++columnNo;
 			}
 
-			if (!mLineBuffer.empty())
-			{
-				const ImVec2 newOffset(textScreenPos.x + bufferOffset.x, textScreenPos.y + bufferOffset.y);
-				drawList->AddText(newOffset, prevColor, mLineBuffer.c_str());
-				mLineBuffer.clear();
-			}
+			unreserve();
 
 			++lineNo;
 		}
+
+		drawList->PopTextureID();
 /*
 		// Draw a tooltip on known identifiers/preprocessor symbols
 		if (ImGui::IsMousePosValid())
@@ -1196,6 +1287,7 @@ void TextEditor::Render(const char* aTitle, const ImVec2& aSize, bool aBorder)
 	mWithinRender = true;
 	mTextChanged = false;
 	mCursorPositionChanged = false;
+	mCursorBlinking = false;
 
 	ImGui::PushStyleColor(ImGuiCol_ChildBg, ImGui::ColorConvertU32ToFloat4(mPalette[(int)PaletteIndex::Background]));
 	ImGui::PushStyleVar(ImGuiStyleVar_ItemSpacing, ImVec2(0.0f, 0.0f));
@@ -1206,6 +1298,8 @@ void TextEditor::Render(const char* aTitle, const ImVec2& aSize, bool aBorder)
 		ImGui::BeginChild(aTitle, aSize, aBorder, winFlags);
 	}
 
+	UpdateLayoutMetrics();
+
 	if (mHandleKeyboardInputs)
 	{
 		HandleKeyboardInputs();
@@ -1226,6 +1320,7 @@ void TextEditor::Render(const char* aTitle, const ImVec2& aSize, bool aBorder)
         mFocusBack = false;
     }
 
+	PollAutoComplete();
 	if (mShowAutoComplete) {
 		RenderAutoComplete(mAutoCompletePos);
 	}
@@ -1239,23 +1334,31 @@ void TextEditor::Render(const char* aTitle, const ImVec2& aSize, bool aBorder)
 	mWithinRender = false;
 }
 
-void TextEditor::SetText(const std::string & aText)
+void TextEditor::SetText(std::string_view aText)
 {
 	mLines.clear();
-	mLines.emplace_back(Line());
-	for (auto chr : aText)
+
+	Line current;
+	auto p = aText.data();
+	auto end = p + aText.size();
+	for (;;)
 	{
-		if (chr == '\r')
-		{
-			// ignore the carriage return character
-		}
-		else if (chr == '\n')
-			mLines.emplace_back(Line());
-		else
+		auto lineBreak = TextScan::FindLineBreak(p, end);
+		current.mChars.append(p, lineBreak);
+		if (lineBreak == end)
+			break;
+
+		// carriage return characters are ignored
+		if (*lineBreak == '\n')
 		{
-			mLines.back().emplace_back(Glyph(chr, PaletteIndex::Default));
+			current.mAttrs.assign(current.size(), GlyphAttr(0));
+			mLines.push_back(std::move(current));
+			current = Line();
 		}
+		p = lineBreak + 1;
 	}
+	current.mAttrs.assign(current.size(), GlyphAttr(0));
+	mLines.push_back(std::move(current));
 
 	mTextChanged = true;
 	mScrollToTop = true;
@@ -1266,6 +1369,74 @@ void TextEditor::SetText(const std::string & aText)
 	Colorize();
 }
 
+void TextEditor::SetTextView(std::string_view aText, std::shared_ptr<const void> aOwner)
+{
+	CancelColorizeJob();
+
+	// Only find where each block of lines starts, the lines within a block are split when it is loaded
+	std::vector<std::pair<size_t, int>> blocks;
+	auto begin = aText.data();
+	auto end = begin + aText.size();
+	size_t blockStart = 0;
+	int count = 0;
+	for (auto p = begin; ; )
+	{
+		auto lineEnd = (const char*)memchr(p, '\n', end - p);
+		++count;
+		if (lineEnd == nullptr)
+		{
+			blocks.emplace_back(blockStart, count);
+			break;
+		}
+
+		p = lineEnd + 1;
+		if (count == Lines::kMaxBlockLines)
+		{
+			blocks.emplace_back(blockStart, count);
+			blockStart = p - begin;
+			count = 0;
+		}
+	}
+
+	mLines.assign_lazy(blocks, [begin, end, aOwner](size_t aOffset, int aCount, std::vector<Line>& aLines)
+	{
+		auto p = begin + aOffset;
+		for (int i = 0; i < aCount; ++i)
+		{
+			auto lineEnd = (const char*)memchr(p, '\n', end - p);
+			if (lineEnd == nullptr)
+				lineEnd = end;
+
+			// carriage return characters are ignored, as in SetText()
+			auto& line = aLines.emplace_back();
+			for (auto q = p; q < lineEnd; )
+			{
+				auto lineBreak = TextScan::FindLineBreak(q, lineEnd);
+				line.mChars.append(q, lineBreak);
+				q = lineBreak + 1;
+			}
+			line.mAttrs.assign(line.size(), GlyphAttr(0));
+
+			p = std::min(lineEnd + 1, end);
+		}
+	});
+
+	mReadOnly = true;
+	mColorizerEnabled = false;
+
+	// Nothing is colored in a view, drop what was still pending for the previous text
+	mCheckComments = false;
+	mCommentRangeMin = std::numeric_limits<int>::max();
+	mColorRangeMin = std::numeric_limits<int>::max();
+	mColorRangeMax = 0;
+
+	mTextChanged = true;
+	mScrollToTop = true;
+
+	mUndoBuffer.clear();
+	mUndoIndex = 0;
+}
+
 void TextEditor::SetTextLines(const std::vector<std::string> & aLines)
 {
 	mLines.clear();
@@ -1276,15 +1447,11 @@ void TextEditor::SetTextLines(const std::vector<std::string> & aLines)
 	}
 	else
 	{
-		mLines.resize(aLines.size());
-
 		for (size_t i = 0; i < aLines.size(); ++i)
 		{
 			const std::string & aLine = aLines[i];
 
-			mLines[i].reserve(aLine.size());
-			for (size_t j = 0; j < aLine.size(); ++j)
-				mLines[i].emplace_back(Glyph(aLine[j], PaletteIndex::Default));
+			mLines.push_back(Line(aLine.data(), aLine.data() + aLine.size()));
 		}
 	}
 
@@ -1340,16 +1507,16 @@ void TextEditor::EnterCharacter(ImWchar aChar, bool aShift)
 				{
 					if (!line.empty())
 					{
-						if (line.front().mChar == '\t')
+						if (line[0] == '\t')
 						{
-							line.erase(line.begin());
+							line.erase(0);
 							modified = true;
 						}
 						else
 						{
-							for (int j = 0; j < mTabSize && !line.empty() && line.front().mChar == ' '; j++)
+							for (int j = 0; j < mTabSize && !line.empty() && line[0] == ' '; j++)
 							{
-								line.erase(line.begin());
+								line.erase(0);
 								modified = true;
 							}
 						}
@@ -1357,7 +1524,7 @@ void TextEditor::EnterCharacter(ImWchar aChar, bool aShift)
 				}
 				else
 				{
-					line.insert(line.begin(), Glyph('\t', TextEditor::PaletteIndex::Background));
+					line.insert(0, '\t', MakeGlyphAttr(PaletteIndex::Background));
 					modified = true;
 				}
 			}
@@ -1388,6 +1555,7 @@ void TextEditor::EnterCharacter(ImWchar aChar, bool aShift)
 				AddUndo(u);
 
 				mTextChanged = true;
+				Colorize(start.mLine, end.mLine - start.mLine + 1);
 
 				EnsureCursorVisible();
 			}
@@ -1415,13 +1583,16 @@ void TextEditor::EnterCharacter(ImWchar aChar, bool aShift)
 		auto& newLine = mLines[coord.mLine + 1];
 
 		if (mLanguageDefinition.mAutoIndentation)
-			for (size_t it = 0; it < line.size() && isascii(line[it].mChar) && isblank(line[it].mChar); ++it)
-				newLine.push_back(line[it]);
+		{
+			auto text = line.mChars.data();
+			auto indent = TextScan::SkipBlanks(text, text + line.size()) - text;
+			newLine.insert(0, line, 0, indent);
+		}
 
 		const size_t whitespaceSize = newLine.size();
 		auto cindex = GetCharacterIndex(coord);
-		newLine.insert(newLine.end(), line.begin() + cindex, line.end());
-		line.erase(line.begin() + cindex, line.begin() + line.size());
+		newLine.insert(newLine.size(), line, cindex, line.size());
+		line.erase(cindex, line.size());
 		SetCursorPosition(Coordinates(coord.mLine + 1, GetCharacterColumn(coord.mLine + 1, (int)whitespaceSize)));
 		u.mAdded = (char)aChar;
 	}
@@ -1437,20 +1608,20 @@ void TextEditor::EnterCharacter(ImWchar aChar, bool aShift)
 
 			if (mOverwrite && cindex < (int)line.size())
 			{
-				auto d = UTF8CharLength(line[cindex].mChar);
+				auto d = UTF8CharLength(line[cindex]);
 
 				u.mRemovedStart = mState.mCursorPosition;
 				u.mRemovedEnd = Coordinates(coord.mLine, GetCharacterColumn(coord.mLine, cindex + d));
 
 				while (d-- > 0 && cindex < (int)line.size())
 				{
-					u.mRemoved += line[cindex].mChar;
-					line.erase(line.begin() + cindex);
+					u.mRemoved += line[cindex];
+					line.erase(cindex);
 				}
 			}
 
 			for (auto p = buf; *p != '\0'; p++, ++cindex)
-				line.insert(line.begin() + cindex, Glyph(*p, PaletteIndex::Default));
+				line.insert(cindex, *p);
 			u.mAdded = buf;
 
 			SetCursorPosition(Coordinates(coord.mLine, GetCharacterColumn(coord.mLine, cindex)));
@@ -1700,7 +1871,7 @@ void TextEditor::MoveLeft(int aAmount, bool aSelect, bool aWordMode)
 			{
 				if ((int)mLines.size() > line)
 				{
-					while (cindex > 0 && IsUTFSequence(mLines[line][cindex].mChar))
+					while (cindex > 0 && IsUTFSequence(mLines[line][cindex]))
 						--cindex;
 				}
 			}
@@ -1761,7 +1932,7 @@ void TextEditor::MoveRight(int aAmount, bool aSelect, bool aWordMode)
 		}
 		else
 		{
-			cindex += UTF8CharLength(line[cindex].mChar);
+			cindex += UTF8CharLength(line[cindex]);
 			mState.mCursorPosition = Coordinates(lindex, GetCharacterColumn(lindex, cindex));
 			if (aWordMode)
 				mState.mCursorPosition = FindNextWord(mState.mCursorPosition);
@@ -1904,7 +2075,7 @@ void TextEditor::Delete()
 			Advance(u.mRemovedEnd);
 
 			auto& nextLine = mLines[pos.mLine + 1];
-			line.insert(line.end(), nextLine.begin(), nextLine.end());
+			line.append(nextLine);
 			RemoveLine(pos.mLine + 1);
 		}
 		else
@@ -1914,9 +2085,9 @@ void TextEditor::Delete()
 			u.mRemovedEnd.mColumn++;
 			u.mRemoved = GetText(u.mRemovedStart, u.mRemovedEnd);
 
-			auto d = UTF8CharLength(line[cindex].mChar);
+			auto d = UTF8CharLength(line[cindex]);
 			while (d-- > 0 && cindex < (int)line.size())
-				line.erase(line.begin() + cindex);
+				line.erase(cindex);
 		}
 
 		mTextChanged = true;
@@ -1963,7 +2134,7 @@ void TextEditor::Backspace()
 			auto& line = mLines[mState.mCursorPosition.mLine];
 			auto& prevLine = mLines[mState.mCursorPosition.mLine - 1];
 			auto prevSize = GetLineMaxColumn(mState.mCursorPosition.mLine - 1);
-			prevLine.insert(prevLine.end(), line.begin(), line.end());
+			prevLine.append(line);
 
 			ErrorMarkers etmp;
 			for (auto& i : mErrorMarkers)
@@ -1979,10 +2150,10 @@ void TextEditor::Backspace()
 			auto& line = mLines[mState.mCursorPosition.mLine];
 			auto cindex = GetCharacterIndex(pos) - 1;
 			auto cend = cindex + 1;
-			while (cindex > 0 && IsUTFSequence(line[cindex].mChar))
+			while (cindex > 0 && IsUTFSequence(line[cindex]))
 				--cindex;
 
-			//if (cindex > 0 && UTF8CharLength(line[cindex].mChar) > 1)
+			//if (cindex > 0 && UTF8CharLength(line[cindex]) > 1)
 			//	--cindex;
 
 			u.mRemovedStart = u.mRemovedEnd = GetActualCursorCoordinates();
@@ -1991,8 +2162,8 @@ void TextEditor::Backspace()
 
 			while (cindex < line.size() && cend-- > cindex)
 			{
-				u.mRemoved += line[cindex].mChar;
-				line.erase(line.begin() + cindex);
+				u.mRemoved += line[cindex];
+				line.erase(cindex);
 			}
 		}
 
@@ -2006,7 +2177,7 @@ void TextEditor::Backspace()
 	AddUndo(u);
 
 	// If we are already in auto completion state, lets keep updating it
-	if (mShowAutoComplete) {
+	if (mShowAutoComplete || mAutoCompleteRequest) {
 		StartAutoComplete(GetActualCursorCoordinates());
 	}
 }
@@ -2037,11 +2208,8 @@ void TextEditor::Copy()
 	{
 		if (!mLines.empty())
 		{
-			std::string str;
 			auto& line = mLines[GetActualCursorCoordinates().mLine];
-			for (auto& g : line)
-				str.push_back(g.mChar);
-			ImGui::SetClipboardText(str.c_str());
+			ImGui::SetClipboardText(line.mChars.c_str());
 		}
 	}
 }
@@ -2223,16 +2391,7 @@ std::vector<std::string> TextEditor::GetTextLines() const
 	result.reserve(mLines.size());
 
 	for (auto & line : mLines)
-	{
-		std::string text;
-
-		text.resize(line.size());
-
-		for (size_t i = 0; i < line.size(); ++i)
-			text[i] = line[i].mChar;
-
-		result.emplace_back(std::move(text));
-	}
+		result.emplace_back(line.mChars);
 
 	return result;
 }
@@ -2261,7 +2420,16 @@ void TextEditor::Colorize(int aFromLine, int aLines)
 	mColorRangeMax = std::max(mColorRangeMax, toLine);
 	mColorRangeMin = std::max(0, mColorRangeMin);
 	mColorRangeMax = std::max(mColorRangeMin, mColorRangeMax);
+	mCommentRangeMin = std::min(mCommentRangeMin, std::max(0, aFromLine));
+	mCommentRangeMax = std::max(mCommentRangeMax, toLine);
 	mCheckComments = true;
+	++mTextVersion;
+
+	if (mColorizeInFlight)
+	{
+		mColorizeCleanHead = std::min(mColorizeCleanHead, std::max(0, aFromLine));
+		mColorizeCleanTail = std::min(mColorizeCleanTail, (int)mLines.size() - toLine);
+	}
 }
 
 void TextEditor::ColorizeRange(int aFromLine, int aToLine)
@@ -2269,288 +2437,530 @@ void TextEditor::ColorizeRange(int aFromLine, int aToLine)
 	if (mLines.empty() || aFromLine >= aToLine)
 		return;
 
-	std::string buffer;
 	std::cmatch results;
 	std::string id;
 
 	int endLine = std::max(0, std::min((int)mLines.size(), aToLine));
 	for (int i = aFromLine; i < endLine; ++i)
-	{
-		auto& line = mLines[i];
+		ColorizeLine(mLines[i], results, id);
+}
 
-		if (line.empty())
-			continue;
+// Only reads the language definition, so it is safe to run on the colorizer thread
+void TextEditor::ColorizeLine(Line& line, std::cmatch& results, std::string& id) const
+{
+	if (line.empty())
+		return;
 
-		buffer.resize(line.size());
-		for (size_t j = 0; j < line.size(); ++j)
-		{
-			auto& col = line[j];
-			buffer[j] = col.mChar;
-			col.mColorIndex = PaletteIndex::Default;
-		}
+	// Reset the colors, the comment and preprocessor flags are owned by ColorizeInternal
+	for (auto& attr : line.mAttrs)
+		attr &= ~GlyphColorMask;
 
-		const char * bufferBegin = &buffer.front();
-		const char * bufferEnd = bufferBegin + buffer.size();
+	const char * bufferBegin = line.mChars.data();
+	const char * bufferEnd = bufferBegin + line.mChars.size();
 
-		auto last = bufferEnd;
+	auto last = bufferEnd;
 
-		for (auto first = bufferBegin; first != last; )
-		{
-			const char * token_begin = nullptr;
-			const char * token_end = nullptr;
-			PaletteIndex token_color = PaletteIndex::Default;
+	for (auto first = bufferBegin; first != last; )
+	{
+		const char * token_begin = nullptr;
+		const char * token_end = nullptr;
+		PaletteIndex token_color = PaletteIndex::Default;
 
-			bool hasTokenizeResult = false;
+		bool hasTokenizeResult = false;
 
-			if (mLanguageDefinition.mTokenize != nullptr)
-			{
-				if (mLanguageDefinition.mTokenize(first, last, token_begin, token_end, token_color))
-					hasTokenizeResult = true;
-			}
+		if (mLanguageDefinition.mTokenize != nullptr)
+		{
+			if (mLanguageDefinition.mTokenize(first, last, token_begin, token_end, token_color))
+				hasTokenizeResult = true;
+		}
 
-			if (hasTokenizeResult == false)
-			{
-				// todo : remove
-				//printf("using regex for %.*s\n", first + 10 < last ? 10 : int(last - first), first);
+		if (hasTokenizeResult == false)
+		{
+			// todo : remove
+			//printf("using regex for %.*s\n", first + 10 < last ? 10 : int(last - first), first);
 
-				for (auto& p : mRegexList)
+			for (auto& p : mRegexList)
+			{
+				if (std::regex_search(first, last, results, p.first, std::regex_constants::match_continuous))
 				{
-					if (std::regex_search(first, last, results, p.first, std::regex_constants::match_continuous))
-					{
-						hasTokenizeResult = true;
+					hasTokenizeResult = true;
 
-						auto& v = *results.begin();
-						token_begin = v.first;
-						token_end = v.second;
-						token_color = p.second;
-						break;
-					}
+					auto& v = *results.begin();
+					token_begin = v.first;
+					token_end = v.second;
+					token_color = p.second;
+					break;
 				}
 			}
+		}
+
+		if (hasTokenizeResult == false)
+		{
+			first++;
+		}
+		else
+		{
+			const size_t token_length = token_end - token_begin;
 
-			if (hasTokenizeResult == false)
+			if (token_color == PaletteIndex::Identifier && mLanguageDefinition.mClassify != nullptr)
 			{
-				first++;
+				token_color = mLanguageDefinition.mClassify(token_begin, token_end, (line.mAttrs[first - bufferBegin] & GlyphPreprocessor) != 0);
 			}
-			else
+			else if (token_color == PaletteIndex::Identifier)
 			{
-				const size_t token_length = token_end - token_begin;
+				id.assign(token_begin, token_end);
 
-				if (token_color == PaletteIndex::Identifier)
+				// todo : allmost all language definitions use lower case to specify keywords, so shouldn't this use ::tolower ?
+				if (!mLanguageDefinition.mCaseSensitive)
+					std::transform(id.begin(), id.end(), id.begin(), ::toupper);
+
+				if (!(line.mAttrs[first - bufferBegin] & GlyphPreprocessor))
+				{
+					if (mLanguageDefinition.mKeywords.count(id) != 0)
+						token_color = PaletteIndex::Keyword;
+					else if (mLanguageDefinition.mIdentifiers.count(id) != 0)
+						token_color = PaletteIndex::KnownIdentifier;
+					else if (mLanguageDefinition.mPreprocIdentifiers.count(id) != 0)
+						token_color = PaletteIndex::PreprocIdentifier;
+				}
+				else
 				{
-					id.assign(token_begin, token_end);
+					if (mLanguageDefinition.mPreprocIdentifiers.count(id) != 0)
+						token_color = PaletteIndex::PreprocIdentifier;
+				}
+			}
 
-					// todo : allmost all language definitions use lower case to specify keywords, so shouldn't this use ::tolower ?
-					if (!mLanguageDefinition.mCaseSensitive)
-						std::transform(id.begin(), id.end(), id.begin(), ::toupper);
+			auto attr = line.mAttrs.begin() + (token_begin - bufferBegin);
+			for (size_t j = 0; j < token_length; ++j, ++attr)
+				*attr = (*attr & ~GlyphColorMask) | MakeGlyphAttr(token_color);
 
-					if (!line[first - bufferBegin].mPreprocessor)
-					{
-						if (mLanguageDefinition.mKeywords.count(id) != 0)
-							token_color = PaletteIndex::Keyword;
-						else if (mLanguageDefinition.mIdentifiers.count(id) != 0)
-							token_color = PaletteIndex::KnownIdentifier;
-						else if (mLanguageDefinition.mPreprocIdentifiers.count(id) != 0)
-							token_color = PaletteIndex::PreprocIdentifier;
-					}
-					else
-					{
-						if (mLanguageDefinition.mPreprocIdentifiers.count(id) != 0)
-							token_color = PaletteIndex::PreprocIdentifier;
-					}
-				}
+			first = token_end;
+		}
+	}
+}
 
-				for (size_t j = 0; j < token_length; ++j)
-					line[(token_begin - bufferBegin) + j].mColorIndex = token_color;
+void TextEditor::ColorizeWorker(std::stop_token aStop)
+{
+	std::cmatch results;
+	std::string id;
 
-				first = token_end;
-			}
+	for (;;)
+	{
+		ColorizeJob job;
+		{
+			std::unique_lock<std::mutex> lock(mColorizeMutex);
+			if (!mColorizeCondition.wait(lock, aStop, [this] { return mColorizeJob.has_value(); }))
+				return;
+
+			job = std::move(*mColorizeJob);
+			mColorizeJob.reset();
+			mColorizeBusy = true;
+		}
+
+		for (auto& line : job.mLines)
+		{
+			if (aStop.stop_requested())
+				break;
+			ColorizeLine(line, results, id);
+		}
+
+		{
+			std::lock_guard<std::mutex> lock(mColorizeMutex);
+			mColorizeResult = std::move(job);
+			mColorizeBusy = false;
 		}
+		mColorizeCondition.notify_all();
+
+		if (mRedrawCallback)
+			mRedrawCallback();
 	}
 }
 
-void TextEditor::ColorizeInternal()
+void TextEditor::StartColorizeJob(int aFromLine, int aToLine)
 {
-	if (mLines.empty() || !mColorizerEnabled)
+	ColorizeJob job;
+	job.mFromLine = aFromLine;
+	job.mTotalLines = (int)mLines.size();
+	job.mLines.reserve(aToLine - aFromLine);
+	for (int i = aFromLine; i < aToLine; ++i)
+		job.mLines.push_back(mLines[i]);
+
+	if (!mColorizeThread.joinable())
+		mColorizeThread = std::jthread([this](std::stop_token aStop) { ColorizeWorker(aStop); });
+
+	{
+		std::lock_guard<std::mutex> lock(mColorizeMutex);
+		mColorizeJob = std::move(job);
+	}
+	mColorizeCondition.notify_all();
+	mColorizeInFlight = true;
+	mColorizeCleanHead = (int)mLines.size();
+	mColorizeCleanTail = (int)mLines.size();
+}
+
+void TextEditor::ApplyColorizeResult()
+{
+	std::optional<ColorizeJob> result;
+	{
+		std::lock_guard<std::mutex> lock(mColorizeMutex);
+		result.swap(mColorizeResult);
+	}
+	if (!result)
 		return;
 
-	if (mCheckComments)
+	mColorizeInFlight = false;
+
+	// Edits made while the worker was busy were queued by Colorize() already. Lines above them
+	// kept their index, lines below them moved by the change in line count, both are applied.
+	// Lines in between can't be located anymore and the whole span between the edits is redone.
+	auto& job = *result;
+	auto count = (int)job.mLines.size();
+	auto shift = (int)mLines.size() - job.mTotalLines;
+	auto lost = false;
+	for (int i = 0; i < count; ++i)
 	{
-		auto endLine = mLines.size();
-		auto endIndex = 0;
-		auto commentStartLine = endLine;
-		auto commentStartIndex = endIndex;
-		auto withinString = false;
-		auto withinSingleLineComment = false;
-		auto withinPreproc = false;
-		auto firstChar = true;			// there is no other non-whitespace characters in the line before
-		auto concatenate = false;		// '\' on the very end of the line
-		auto currentLine = 0;
-		auto currentIndex = 0;
-		while (currentLine < endLine || currentIndex < endIndex)
+		auto line = job.mFromLine + i;
+		if (line >= mColorizeCleanHead)
 		{
-			auto& line = mLines[currentLine];
-
-			if (currentIndex == 0 && !concatenate)
+			if (job.mTotalLines - line > mColorizeCleanTail)
 			{
-				withinSingleLineComment = false;
-				withinPreproc = false;
-				firstChar = true;
+				lost = true;
+				continue;
 			}
+			line += shift;
+		}
+		if (line < 0 || line >= (int)mLines.size())
+			continue;
 
-			concatenate = false;
+		// Tokens also depend on the preprocessor flags. Those have to match the copy and must be
+		// final, a comment scan still in progress may change them again.
+		auto& src = job.mLines[i];
+		auto& dst = mLines[line];
+		auto same = src.mChars == dst.mChars && !(mCheckComments && line >= mCommentRangeMin);
+		for (size_t j = 0; same && j < dst.size(); ++j)
+			same = (src.mAttrs[j] & ~GlyphColorMask) == (dst.mAttrs[j] & ~GlyphColorMask);
+		if (!same)
+		{
+			mColorRangeMin = std::min(mColorRangeMin, line);
+			mColorRangeMax = std::max(mColorRangeMax, line + 1);
+			continue;
+		}
 
-			if (!line.empty())
-			{
-				auto& g = line[currentIndex];
-				auto c = g.mChar;
+		for (size_t j = 0; j < dst.size(); ++j)
+			dst.mAttrs[j] = (dst.mAttrs[j] & ~GlyphColorMask) | (src.mAttrs[j] & GlyphColorMask);
+	}
 
-				if (c != mLanguageDefinition.mPreprocChar && !isspace(c))
-					firstChar = false;
+	if (lost)
+	{
+		mColorRangeMin = std::min(mColorRangeMin, mColorizeCleanHead);
+		mColorRangeMax = std::max(mColorRangeMax, (int)mLines.size() - mColorizeCleanTail);
+	}
+}
 
-				if (currentIndex == (int)line.size() - 1 && line[line.size() - 1].mChar == '\\')
-					concatenate = true;
+void TextEditor::CancelColorizeJob()
+{
+	if (!mColorizeThread.joinable())
+		return;
 
-				bool inComment = (commentStartLine < currentLine || (commentStartLine == currentLine && commentStartIndex <= currentIndex));
+	std::unique_lock<std::mutex> lock(mColorizeMutex);
+	mColorizeJob.reset();
+	mColorizeCondition.wait(lock, [this] { return !mColorizeBusy; });
+	mColorizeResult.reset();
+	mColorizeInFlight = false;
+}
 
-				if (withinString)
-				{
-					//printf("in string!\n");
-					line[currentIndex].mMultiLineComment = inComment;
+TextEditor::LexState TextEditor::ColorizeComments(Line& aLine, LexState aEntryState) const
+{
+	auto withinComment = (aEntryState & LexBlockComment) != 0;
+	auto withinString = (aEntryState & LexString) != 0;
+	auto concatenate = (aEntryState & LexContinued) != 0;		// '\' on the very end of the previous line
+	auto withinSingleLineComment = concatenate && (aEntryState & LexSingleLineComment) != 0;
+	auto withinPreproc = concatenate && (aEntryState & LexPreproc) != 0;
+	auto firstChar = !concatenate || (aEntryState & LexFirstChar) != 0;	// there is no other non-whitespace characters in the line before
 
-					if (c == '\"')
-					{
-						if (currentIndex + 1 < (int)line.size() && line[currentIndex + 1].mChar == '\"')
-						{
-							currentIndex += 1;
-							if (currentIndex < (int)line.size())
-								line[currentIndex].mMultiLineComment = inComment;
-						}
-						else
-							withinString = false;
-					}
-					else if (c == '\\')
-					{
-						currentIndex += 1;
-						if (currentIndex < (int)line.size())
-							line[currentIndex].mMultiLineComment = inComment;
-					}
-					//printf("done string!\n");
-				}
-				else
-				{
-					if (firstChar && c == mLanguageDefinition.mPreprocChar)
-						withinPreproc = true;
+	auto& startStr = mLanguageDefinition.mCommentStart;
+	auto& endStr = mLanguageDefinition.mCommentEnd;
+	auto& singleStartStr = mLanguageDefinition.mSingleLineComment;
 
-					if (c == '\"')
-					{
-						withinString = true;
-						line[currentIndex].mMultiLineComment = inComment;
-						//printf("start string!\n");
-					}
-					else
-					{
-						auto pred = [](const char& a, const Glyph& b) { return a == b.mChar; };
-						auto from = line.begin() + currentIndex;
-						auto& startStr = mLanguageDefinition.mCommentStart;
-						auto& singleStartStr = mLanguageDefinition.mSingleLineComment;
-
-						if (singleStartStr.size() > 0 &&
-							currentIndex + singleStartStr.size() <= line.size() &&
-							equals(singleStartStr.begin(), singleStartStr.end(), from, from + singleStartStr.size(), pred))
-						{
-							withinSingleLineComment = true;
-						}
-						else if (!withinSingleLineComment && currentIndex + startStr.size() <= line.size() &&
-							equals(startStr.begin(), startStr.end(), from, from + startStr.size(), pred))
-						{
-							commentStartLine = currentLine;
-							commentStartIndex = currentIndex;
-						}
+	concatenate = false;
 
-						inComment = inComment = (commentStartLine < currentLine || (commentStartLine == currentLine && commentStartIndex <= currentIndex));
+	// Characters skipped below (escaped or multi-byte) must not keep flags from an earlier scan
+	for (auto& attr : aLine.mAttrs)
+		attr &= GlyphColorMask;
 
-						line[currentIndex].mMultiLineComment = inComment;
-						line[currentIndex].mComment = withinSingleLineComment;
+	auto size = (int)aLine.size();
+	for (int currentIndex = 0; currentIndex < size; )
+	{
+		auto c = aLine[currentIndex];
 
-						auto& endStr = mLanguageDefinition.mCommentEnd;
-						if (currentIndex + 1 >= (int)endStr.size() &&
-							equals(endStr.begin(), endStr.end(), from + 1 - endStr.size(), from + 1, pred))
-						{
-							commentStartIndex = endIndex;
-							commentStartLine = endLine;
-						}
-					}
+		if (c != mLanguageDefinition.mPreprocChar && !isspace(c))
+			firstChar = false;
+
+		concatenate = currentIndex == size - 1 && c == '\\';
+
+		if (withinString)
+		{
+			SetGlyphFlag(aLine.mAttrs[currentIndex], GlyphMultiLineComment, withinComment);
+
+			if (c == '\"')
+			{
+				if (currentIndex + 1 < size && aLine[currentIndex + 1] == '\"')
+				{
+					currentIndex += 1;
+					if (currentIndex < size)
+						SetGlyphFlag(aLine.mAttrs[currentIndex], GlyphMultiLineComment, withinComment);
+				}
+				else
+					withinString = false;
+			}
+			else if (c == '\\')
+			{
+				currentIndex += 1;
+				if (currentIndex < size)
+					SetGlyphFlag(aLine.mAttrs[currentIndex], GlyphMultiLineComment, withinComment);
+			}
+		}
+		else
+		{
+			if (firstChar && c == mLanguageDefinition.mPreprocChar)
+				withinPreproc = true;
+
+			if (c == '\"')
+			{
+				withinString = true;
+				SetGlyphFlag(aLine.mAttrs[currentIndex], GlyphMultiLineComment, withinComment);
+			}
+			else
+			{
+				if (singleStartStr.size() > 0 &&
+					currentIndex + singleStartStr.size() <= aLine.size() &&
+					aLine.mChars.compare(currentIndex, singleStartStr.size(), singleStartStr) == 0)
+				{
+					withinSingleLineComment = true;
 				}
-				//printf("line index %d, size: %d\n", currentIndex, line.size());
-				// TDOD: A FIX BY REZA
-				if (currentIndex < (int)line.size()) {
-					line[currentIndex].mPreprocessor = withinPreproc;
+				else if (!withinSingleLineComment && currentIndex + startStr.size() <= aLine.size() &&
+					aLine.mChars.compare(currentIndex, startStr.size(), startStr) == 0)
+				{
+					withinComment = true;
 				}
-				currentIndex += UTF8CharLength(c);
-				
-				//printf("new line index %d\n", currentIndex);
 
-				if (currentIndex >= (int)line.size())
+				SetGlyphFlag(aLine.mAttrs[currentIndex], GlyphMultiLineComment, withinComment);
+				SetGlyphFlag(aLine.mAttrs[currentIndex], GlyphComment, withinSingleLineComment);
+
+				if (currentIndex + 1 >= (int)endStr.size() &&
+					aLine.mChars.compare(currentIndex + 1 - endStr.size(), endStr.size(), endStr) == 0)
 				{
-					currentIndex = 0;
-					++currentLine;
+					withinComment = false;
 				}
 			}
-			else
+		}
+
+		if (currentIndex < size)
+			SetGlyphFlag(aLine.mAttrs[currentIndex], GlyphPreprocessor, withinPreproc);
+		currentIndex += UTF8CharLength(c);
+	}
+
+	LexState exitState = 0;
+	if (withinComment)
+		exitState |= LexBlockComment;
+	if (withinString)
+		exitState |= LexString;
+	if (concatenate)
+	{
+		exitState |= LexContinued;
+		if (withinSingleLineComment)
+			exitState |= LexSingleLineComment;
+		if (withinPreproc)
+			exitState |= LexPreproc;
+		if (firstChar)
+			exitState |= LexFirstChar;
+	}
+	return exitState;
+}
+
+void TextEditor::ColorizeInternal()
+{
+	if (mLines.empty() || !mColorizerEnabled)
+		return;
+
+	if (mCheckComments)
+	{
+		// Rescan from the first edited line and stop once past the edited lines a line is
+		// entered in the same state it was last scanned with, the rest of the file is unaffected.
+		// At most maxLines are scanned per frame, the scan resumes there on the next one.
+		const int maxLines = 10000;
+		auto endLine = (int)mLines.size();
+		auto currentLine = std::min(mCommentRangeMin, endLine);
+		auto lastLine = std::min(endLine, currentLine + maxLines);
+		auto done = true;
+		LexState state = currentLine > 0 ? mLines[currentLine - 1].mLexExit : 0;
+		for (; currentLine < endLine; ++currentLine)
+		{
+			auto& line = mLines[currentLine];
+			if (currentLine >= mCommentRangeMax && line.mLexEntry == state)
+				break;
+
+			if (currentLine == lastLine)
+			{
+				done = false;
+				break;
+			}
+
+			// A new entry state can change the preprocessor flags the tokens were colored with
+			if (line.mLexEntry != state)
 			{
-				currentIndex = 0;
-				++currentLine;
+				mColorRangeMin = std::min(mColorRangeMin, currentLine);
+				mColorRangeMax = std::max(mColorRangeMax, currentLine + 1);
 			}
+
+			line.mLexEntry = state;
+			state = ColorizeComments(line, state);
+			line.mLexExit = state;
+		}
+
+		if (done)
+		{
+			mCommentRangeMin = std::numeric_limits<int>::max();
+			mCommentRangeMax = 0;
+			mCheckComments = false;
 		}
-		mCheckComments = false;
+		else
+			mCommentRangeMin = currentLine;
 	}
 
+	ApplyColorizeResult();
+
 	if (mColorRangeMin < mColorRangeMax)
 	{
-		const int increment = (mLanguageDefinition.mTokenize == nullptr) ? 10 : 10000;
-		const int to = std::min(mColorRangeMin + increment, mColorRangeMax);
-		ColorizeRange(mColorRangeMin, to);
-		mColorRangeMin = to;
+		// Small ranges (typing) are colored right away. Larger ones are handed to the colorizer
+		// thread in chunks while Render() keeps drawing the previous colors.
+		const int syncLines = (mLanguageDefinition.mTokenize == nullptr) ? 10 : 200;
+		const int chunkLines = 10000;
+
+		mColorRangeMax = std::min(mColorRangeMax, (int)mLines.size());
+
+		// Tokens depend on the preprocessor flags, so stay behind a comment scan still in progress
+		int to = mCheckComments ? std::min(mColorRangeMax, mCommentRangeMin) : mColorRangeMax;
+		if (to <= mColorRangeMin)
+			return;
+
+		if (to - mColorRangeMin <= syncLines)
+		{
+			ColorizeRange(mColorRangeMin, to);
+		}
+		else if (!mColorizeInFlight)
+		{
+			to = std::min(mColorRangeMin + chunkLines, to);
+			StartColorizeJob(mColorRangeMin, to);
+		}
+		else
+			return;
 
-		if (mColorRangeMax == mColorRangeMin)
+		mColorRangeMin = to;
+		if (mColorRangeMax <= mColorRangeMin)
 		{
 			mColorRangeMin = std::numeric_limits<int>::max();
 			mColorRangeMax = 0;
 		}
-		return;
 	}
 }
 
+float TextEditor::GetRedrawDelay() const
+{
+	// The comment scan and small color ranges advance a slice per frame. A job on the
+	// colorizer thread reports back through mRedrawCallback instead.
+	if (mColorizerEnabled && (mCheckComments || (mColorRangeMin < mColorRangeMax && !mColorizeInFlight)))
+		return 0.0f;
+
+	if (!mCursorBlinking)
+		return -1.0f;
+
+	// The cursor shows up once 400ms have passed and the cycle restarts after 800ms
+	auto now = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+	auto elapsed = (int64_t)(now - mStartTime);
+	auto next = elapsed <= 400 ? 401 : 801;
+	return std::max<int64_t>(next - elapsed, 0) / 1000.0f;
+}
+
 float TextEditor::TextDistanceToLineStart(const Coordinates& aFrom) const
 {
 	auto& line = mLines[aFrom.mLine];
 	float distance = 0.0f;
-	float spaceSize = ImGui::GetFont()->CalcTextSizeA(ImGui::GetFontSize(), FLT_MAX, -1.0f, " ", nullptr, nullptr).x;
 	int colIndex = GetCharacterIndex(aFrom);
-	for (size_t it = 0u; it < line.size() && it < colIndex; )
+	auto it = line.mChars.data();
+	auto end = it + std::min(colIndex, (int)line.size());
+	while (it < end)
 	{
-		if (line[it].mChar == '\t')
+		if (*it == '\t')
 		{
-			distance = (1.0f + std::floor((1.0f + distance) / (float(mTabSize) * spaceSize))) * (float(mTabSize) * spaceSize);
+			distance = TabStop(distance);
 			++it;
 		}
 		else
 		{
-			auto d = UTF8CharLength(line[it].mChar);
-			char tempCString[7];
-			int i = 0;
-			for (; i < 6 && d-- > 0 && it < (int)line.size(); i++, it++)
-				tempCString[i] = line[it].mChar;
-
-			tempCString[i] = '\0';
-			distance += ImGui::GetFont()->CalcTextSizeA(ImGui::GetFontSize(), FLT_MAX, -1.0f, tempCString, nullptr, nullptr).x;
+			// measure everything up to the next tab at once
+			auto run = (const char*)memchr(it, '\t', end - it);
+			if (run == nullptr)
+				run = end;
+			distance += TextWidth(it, run);
+			it = run;
 		}
 	}
 
 	return distance;
 }
 
+void TextEditor::UpdateLayoutMetrics()
+{
+	auto font = ImGui::GetFont();
+	auto fontSize = ImGui::GetFontSize();
+	if (font == mLayoutFont && fontSize == mLayoutFontSize && mTabSize == mLayoutTabSize)
+		return;
+
+	mLayoutFont = font;
+	mLayoutFontSize = fontSize;
+	mLayoutTabSize = mTabSize;
+	++mLayoutGeneration;
+
+	for (int c = 0; c < 128; ++c)
+	{
+		char text = (char)c;
+		mAsciiAdvance[c] = font->CalcTextSizeA(fontSize, FLT_MAX, -1.0f, &text, &text + 1, nullptr).x;
+		mAsciiGlyphs[c] = font->FindGlyph((ImWchar)c);
+	}
+	mSpaceAdvance = mAsciiAdvance[' '];
+}
+
+float TextEditor::TextWidth(const char* aBegin, const char* aEnd) const
+{
+	// ASCII text is measured from the advance table, anything else goes through the font
+	float width = 0.0f;
+	for (auto p = aBegin; p < aEnd; ++p)
+	{
+		auto c = (Char)*p;
+		if (c >= 128)
+			return ImGui::GetFont()->CalcTextSizeA(ImGui::GetFontSize(), FLT_MAX, -1.0f, aBegin, aEnd, nullptr).x;
+		width += mAsciiAdvance[c];
+	}
+	return width;
+}
+
+float TextEditor::TabStop(float aX) const
+{
+	return (1.0f + std::floor((1.0f + aX) / (float(mTabSize) * mSpaceAdvance))) * (float(mTabSize) * mSpaceAdvance);
+}
+
+float TextEditor::GetLineWidth(int aLine) const
+{
+	auto& line = mLines[aLine];
+	if (line.mWidth < 0.0f || line.mWidthGeneration != mLayoutGeneration)
+	{
+		line.mWidth = TextDistanceToLineStart(Coordinates(aLine, GetLineMaxColumn(aLine)));
+		line.mWidthGeneration = mLayoutGeneration;
+	}
+	return line.mWidth;
+}
+
 void TextEditor::EnsureCursorVisible()
 {
 	if (!mWithinRender)
@@ -2650,477 +3060,3 @@ void TextEditor::UndoRecord::Redo(TextEditor * aEditor)
 	aEditor->mState = mAfter;
 	aEditor->EnsureCursorVisible();
 }
-
-static bool TokenizeCStyleString(const char * in_begin, const char * in_end, const char *& out_begin, const char *& out_end)
-{
-	const char * p = in_begin;
-
-	if (*p == '"')
-	{
-		p++;
-
-		while (p < in_end)
-		{
-			// handle end of string
-			if (*p == '"')
-			{
-				out_begin = in_begin;
-				out_end = p + 1;
-				return true;
-			}
-
-			// handle escape character for "
-			if (*p == '\\' && p + 1 < in_end && p[1] == '"')
-				p++;
-
-			p++;
-		}
-	}
-
-	return false;
-}
-
-static bool TokenizeCStyleCharacterLiteral(const char * in_begin, const char * in_end, const char *& out_begin, const char *& out_end)
-{
-	const char * p = in_begin;
-
-	if (*p == '\'')
-	{
-		p++;
-
-		// handle escape characters
-		if (p < in_end && *p == '\\')
-			p++;
-
-		if (p < in_end)
-			p++;
-
-		// handle end of character literal
-		if (p < in_end && *p == '\'')
-		{
-			out_begin = in_begin;
-			out_end = p + 1;
-			return true;
-		}
-	}
-
-	return false;
-}
-
-static bool TokenizeCStyleIdentifier(const char * in_begin, const char * in_end, const char *& out_begin, const char *& out_end)
-{
-	const char * p = in_begin;
-
-	if ((*p >= 'a' && *p <= 'z') || (*p >= 'A' && *p <= 'Z') || *p == '_')
-	{
-		p++;
-
-		while ((p < in_end) && ((*p >= 'a' && *p <= 'z') || (*p >= 'A' && *p <= 'Z') || (*p >= '0' && *p <= '9') || *p == '_'))
-			p++;
-
-		out_begin = in_begin;
-		out_end = p;
-		return true;
-	}
-
-	return false;
-}
-
-static bool TokenizeCStyleNumber(const char * in_begin, const char * in_end, const char *& out_begin, const char *& out_end)
-{
-	const char * p = in_begin;
-
-	const bool startsWithNumber = *p >= '0' && *p <= '9';
-
-	if (*p != '+' && *p != '-' && !startsWithNumber)
-		return false;
-
-	p++;
-
-	bool hasNumber = startsWithNumber;
-
-	while (p < in_end && (*p >= '0' && *p <= '9'))
-	{
-		hasNumber = true;
-
-		p++;
-	}
-
-	if (hasNumber == false)
-		return false;
-
-	bool isFloat = false;
-	bool isHex = false;
-	bool isBinary = false;
-
-	if (p < in_end)
-	{
-		if (*p == '.')
-		{
-			isFloat = true;
-
-			p++;
-
-			while (p < in_end && (*p >= '0' && *p <= '9'))
-				p++;
-		}
-		else if (*p == 'x' || *p == 'X')
-		{
-			// hex formatted integer of the type 0xef80
-
-			isHex = true;
-
-			p++;
-
-			while (p < in_end && ((*p >= '0' && *p <= '9') || (*p >= 'a' && *p <= 'f') || (*p >= 'A' && *p <= 'F')))
-				p++;
-		}
-		else if (*p == 'b' || *p == 'B')
-		{
-			// binary formatted integer of the type 0b01011101
-
-			isBinary = true;
-
-			p++;
-
-			while (p < in_end && (*p >= '0' && *p <= '1'))
-				p++;
-		}
-	}
-
-	if (isHex == false && isBinary == false)
-	{
-		// floating point exponent
-		if (p < in_end && (*p == 'e' || *p == 'E'))
-		{
-			isFloat = true;
-
-			p++;
-
-			if (p < in_end && (*p == '+' || *p == '-'))
-				p++;
-
-			bool hasDigits = false;
-
-			while (p < in_end && (*p >= '0' && *p <= '9'))
-			{
-				hasDigits = true;
-
-				p++;
-			}
-
-			if (hasDigits == false)
-				return false;
-		}
-
-		// single precision floating point type
-		if (p < in_end && *p == 'f')
-			p++;
-	}
-
-	if (isFloat == false)
-	{
-		// integer size type
-		while (p < in_end && (*p == 'u' || *p == 'U' || *p == 'l' || *p == 'L'))
-			p++;
-	}
-
-	out_begin = in_begin;
-	out_end = p;
-	return true;
-}
-
-static bool TokenizeCStylePunctuation(const char * in_begin, const char * in_end, const char *& out_begin, const char *& out_end)
-{
-	(void)in_end;
-
-	switch (*in_begin)
-	{
-	case '[':
-	case ']':
-	case '{':
-	case '}':
-	case '!':
-	case '%':
-	case '^':
-	case '&':
-	case '*':
-	case '(':
-	case ')':
-	case '-':
-	case '+':
-	case '=':
-	case '~':
-	case '|':
-	case '<':
-	case '>':
-	case '?':
-	case ':':
-	case '/':
-	case ';':
-	case ',':
-	case '.':
-		out_begin = in_begin;
-		out_end = in_begin + 1;
-		return true;
-	}
-
-	return false;
-}
-
-const TextEditor::LanguageDefinition& TextEditor::LanguageDefinition::CPlusPlus()
-{
-	static bool inited = false;
-	static LanguageDefinition langDef;
-	if (!inited)
-	{
-		static const char* const cppKeywords[] = {
-			"alignas", "alignof", "and", "and_eq", "asm", "atomic_cancel", "atomic_commit", "atomic_noexcept", "auto", "bitand", "bitor", "bool", "break", "case", "catch", "char", "char16_t", "char32_t", "class",
-			"compl", "concept", "const", "constexpr", "const_cast", "continue", "decltype", "default", "delete", "do", "double", "dynamic_cast", "else", "enum", "explicit", "export", "extern", "false", "float",
-			"for", "friend", "goto", "if", "import", "inline", "int", "long", "module", "mutable", "namespace", "new", "noexcept", "not", "not_eq", "nullptr", "operator", "or", "or_eq", "private", "protected", "public",
-			"register", "reinterpret_cast", "requires", "return", "short", "signed", "sizeof", "static", "static_assert", "static_cast", "struct", "switch", "synchronized", "template", "this", "thread_local",
-			"throw", "true", "try", "typedef", "typeid", "typename", "union", "unsigned", "using", "virtual", "void", "volatile", "wchar_t", "while", "xor", "xor_eq", "include", "define"
-		};
-		for (auto& k : cppKeywords)
-			langDef.mKeywords.insert(k);
-
-		static const char* const identifiers[] = {
-			"abort", "abs", "acos", "asin", "atan", "atexit", "atof", "atoi", "atol", "ceil", "clock", "cosh", "ctime", "div", "exit", "fabs", "floor", "fmod", "getchar", "getenv", "isalnum", "isalpha", "isdigit", "isgraph",
-			"ispunct", "isspace", "isupper", "kbhit", "log10", "log2", "log", "memcmp", "modf", "pow", "printf", "sprintf", "snprintf", "putchar", "putenv", "puts", "rand", "remove", "rename", "sinh", "sqrt", "srand", "strcat", "strcmp", "strerror", "time", "tolower", "toupper",
-			"std", "string", "vector", "map", "unordered_map", "set", "unordered_set", "min", "max"
-		};
-		for (auto& k : identifiers)
-		{
-			Identifier id;
-			id.mDeclaration = "Built-in function";
-			langDef.mIdentifiers.insert(std::make_pair(std::string(k), id));
-		}
-
-		langDef.mTokenize = [](const char * in_begin, const char * in_end, const char *& out_begin, const char *& out_end, PaletteIndex & paletteIndex) -> bool
-		{
-			paletteIndex = PaletteIndex::Max;
-
-			while (in_begin < in_end && isascii(*in_begin) && isblank(*in_begin))
-				in_begin++;
-
-			if (in_begin == in_end)
-			{
-				out_begin = in_end;
-				out_end = in_end;
-				paletteIndex = PaletteIndex::Default;
-			}
-			else if (TokenizeCStyleString(in_begin, in_end, out_begin, out_end))
-				paletteIndex = PaletteIndex::String;
-			else if (TokenizeCStyleCharacterLiteral(in_begin, in_end, out_begin, out_end))
-				paletteIndex = PaletteIndex::CharLiteral;
-			else if (TokenizeCStyleIdentifier(in_begin, in_end, out_begin, out_end))
-				paletteIndex = PaletteIndex::Identifier;
-			else if (TokenizeCStyleNumber(in_begin, in_end, out_begin, out_end))
-				paletteIndex = PaletteIndex::Number;
-			else if (TokenizeCStylePunctuation(in_begin, in_end, out_begin, out_end))
-				paletteIndex = PaletteIndex::Punctuation;
-
-			return paletteIndex != PaletteIndex::Max;
-		};
-
-		langDef.mCommentStart = "/*";
-		langDef.mCommentEnd = "*/";
-		langDef.mSingleLineComment = "//";
-
-		langDef.mCaseSensitive = true;
-		langDef.mAutoIndentation = true;
-
-		langDef.mName = "C++";
-
-		inited = true;
-	}
-	return langDef;
-}
-
-const TextEditor::LanguageDefinition& TextEditor::LanguageDefinition::HLSL()
-{
-	static bool inited = false;
-	static LanguageDefinition langDef;
-	if (!inited)
-	{
-		static const char* const keywords[] = {
-			"AppendStructuredBuffer", "asm", "asm_fragment", "BlendState", "bool", "break", "Buffer", "ByteAddressBuffer", "case", "cbuffer", "centroid", "class", "column_major", "compile", "compile_fragment",
-			"CompileShader", "const", "continue", "ComputeShader", "ConsumeStructuredBuffer", "default", "DepthStencilState", "DepthStencilView", "discard", "do", "double", "DomainShader", "dword", "else",
-			"export", "extern", "false", "float", "for", "fxgroup", "GeometryShader", "groupshared", "half", "Hullshader", "if", "in", "inline", "inout", "InputPatch", "int", "interface", "line", "lineadj",
-			"linear", "LineStream", "matrix", "min16float", "min10float", "min16int", "min12int", "min16uint", "namespace", "nointerpolation", "noperspective", "NULL", "out", "OutputPatch", "packoffset",
-			"pass", "pixelfragment", "PixelShader", "point", "PointStream", "precise", "RasterizerState", "RenderTargetView", "return", "register", "row_major", "RWBuffer", "RWByteAddressBuffer", "RWStructuredBuffer",
-			"RWTexture1D", "RWTexture1DArray", "RWTexture2D", "RWTexture2DArray", "RWTexture3D", "sample", "sampler", "SamplerState", "SamplerComparisonState", "shared", "snorm", "stateblock", "stateblock_state",
-			"static", "string", "struct", "switch", "StructuredBuffer", "tbuffer", "technique", "technique10", "technique11", "texture", "Texture1D", "Texture1DArray", "Texture2D", "Texture2DArray", "Texture2DMS",
-			"Texture2DMSArray", "Texture3D", "TextureCube", "TextureCubeArray", "true", "typedef", "triangle", "triangleadj", "TriangleStream", "uint", "uniform", "unorm", "unsigned", "vector", "vertexfragment",
-			"VertexShader", "void", "volatile", "while",
-			"bool1","bool2","bool3","bool4","double1","double2","double3","double4", "float1", "float2", "float3", "float4", "int1", "int2", "int3", "int4", "in", "out", "inout",
-			"uint1", "uint2", "uint3", "uint4", "dword1", "dword2", "dword3", "dword4", "half1", "half2", "half3", "half4",
-			"float1x1","float2x1","float3x1","float4x1","float1x2","float2x2","float3x2","float4x2",
-			"float1x3","float2x3","float3x3","float4x3","float1x4","float2x4","float3x4","float4x4",
-			"half1x1","half2x1","half3x1","half4x1","half1x2","half2x2","half3x2","half4x2",
-			"half1x3","half2x3","half3x3","half4x3","half1x4","half2x4","half3x4","half4x4",
-		};
-		for (auto& k : keywords)
-			langDef.mKeywords.insert(k);
-
-		static const char* const identifiers[] = {
-			"abort", "abs", "acos", "all", "AllMemoryBarrier", "AllMemoryBarrierWithGroupSync", "any", "asdouble", "asfloat", "asin", "asint", "asint", "asuint",
-			"asuint", "atan", "atan2", "ceil", "CheckAccessFullyMapped", "clamp", "clip", "cos", "cosh", "countbits", "cross", "D3DCOLORtoUBYTE4", "ddx",
-			"ddx_coarse", "ddx_fine", "ddy", "ddy_coarse", "ddy_fine", "degrees", "determinant", "DeviceMemoryBarrier", "DeviceMemoryBarrierWithGroupSync",
-			"distance", "dot", "dst", "errorf", "EvaluateAttributeAtCentroid", "EvaluateAttributeAtSample", "EvaluateAttributeSnapped", "exp", "exp2",
-			"f16tof32", "f32tof16", "faceforward", "firstbithigh", "firstbitlow", "floor", "fma", "fmod", "frac", "frexp", "fwidth", "GetRenderTargetSampleCount",
-			"GetRenderTargetSamplePosition", "GroupMemoryBarrier", "GroupMemoryBarrierWithGroupSync", "InterlockedAdd", "InterlockedAnd", "InterlockedCompareExchange",
-			"InterlockedCompareStore", "InterlockedExchange", "InterlockedMax", "InterlockedMin", "InterlockedOr", "InterlockedXor", "isfinite", "isinf", "isnan",
-			"ldexp", "length", "lerp", "lit", "log", "log10", "log2", "mad", "max", "min", "modf", "msad4", "mul", "noise", "normalize", "pow", "printf",
-			"Process2DQuadTessFactorsAvg", "Process2DQuadTessFactorsMax", "Process2DQuadTessFactorsMin", "ProcessIsolineTessFactors", "ProcessQuadTessFactorsAvg",
-			"ProcessQuadTessFactorsMax", "ProcessQuadTessFactorsMin", "ProcessTriTessFactorsAvg", "ProcessTriTessFactorsMax", "ProcessTriTessFactorsMin",
-			"radians", "rcp", "reflect", "refract", "reversebits", "round", "rsqrt", "saturate", "sign", "sin", "sincos", "sinh", "smoothstep", "sqrt", "step",
-			"tan", "tanh", "tex1D", "tex1D", "tex1Dbias", "tex1Dgrad", "tex1Dlod", "tex1Dproj", "tex2D", "tex2D", "tex2Dbias", "tex2Dgrad", "tex2Dlod", "tex2Dproj",
-			"tex3D", "tex3D", "tex3Dbias", "tex3Dgrad", "tex3Dlod", "tex3Dproj", "texCUBE", "texCUBE", "texCUBEbias", "texCUBEgrad", "texCUBElod", "texCUBEproj", "transpose", "trunc"
-		};
-		for (auto& k : identifiers)
-		{
-			Identifier id;
-			id.mDeclaration = "Built-in function";
-			langDef.mIdentifiers.insert(std::make_pair(std::string(k), id));
-		}
-
-		langDef.mTokenRegexStrings.push_back(std::make_pair<std::string, PaletteIndex>("[ \\t]*#[ \\t]*[a-zA-Z_]+", PaletteIndex::Preprocessor));
-		langDef.mTokenRegexStrings.push_back(std::make_pair<std::string, PaletteIndex>("L?\\\"(\\\\.|[^\\\"])*\\\"", PaletteIndex::String));
-		langDef.mTokenRegexStrings.push_back(std::make_pair<std::string, PaletteIndex>("\\'\\\\?[^\\']\\'", PaletteIndex::CharLiteral));
-		langDef.mTokenRegexStrings.push_back(std::make_pair<std::string, PaletteIndex>("[+-]?([0-9]+([.][0-9]*)?|[.][0-9]+)([eE][+-]?[0-9]+)?[fF]?", PaletteIndex::Number));
-		langDef.mTokenRegexStrings.push_back(std::make_pair<std::string, PaletteIndex>("[+-]?[0-9]+[Uu]?[lL]?[lL]?", PaletteIndex::Number));
-		langDef.mTokenRegexStrings.push_back(std::make_pair<std::string, PaletteIndex>("0[0-7]+[Uu]?[lL]?[lL]?", PaletteIndex::Number));
-		langDef.mTokenRegexStrings.push_back(std::make_pair<std::string, PaletteIndex>("0[xX][0-9a-fA-F]+[uU]?[lL]?[lL]?", PaletteIndex::Number));
-		langDef.mTokenRegexStrings.push_back(std::make_pair<std::string, PaletteIndex>("[a-zA-Z_][a-zA-Z0-9_]*", PaletteIndex::Identifier));
-		langDef.mTokenRegexStrings.push_back(std::make_pair<std::string, PaletteIndex>("[\\[\\]\\{\\}\\!\\%\\^\\&\\*\\(\\)\\-\\+\\=\\~\\|\\<\\>\\?\\/\\;\\,\\.]", PaletteIndex::Punctuation));
-
-		langDef.mCommentStart = "/*";
-		langDef.mCommentEnd = "*/";
-		langDef.mSingleLineComment = "//";
-
-		langDef.mCaseSensitive = true;
-		langDef.mAutoIndentation = true;
-
-		langDef.mName = "HLSL";
-
-		inited = true;
-	}
-	return langDef;
-}
-
-const TextEditor::LanguageDefinition& TextEditor::LanguageDefinition::GLSL()
-{
-	static bool inited = false;
-	static LanguageDefinition langDef;
-	if (!inited)
-	{
-		static const char* const keywords[] = {
-			"auto", "break", "case", "char", "const", "continue", "default", "do", "double", "else", "enum", "extern", "float", "for", "goto", "if", "inline", "int", "long", "register", "restrict", "return", "short",
-			"signed", "sizeof", "static", "struct", "switch", "typedef", "union", "unsigned", "void", "volatile", "while", "_Alignas", "_Alignof", "_Atomic", "_Bool", "_Complex", "_Generic", "_Imaginary",
-			"_Noreturn", "_Static_assert", "_Thread_local"
-		};
-		for (auto& k : keywords)
-			langDef.mKeywords.insert(k);
-
-		static const char* const identifiers[] = {
-			"abort", "abs", "acos", "asin", "atan", "atexit", "atof", "atoi", "atol", "ceil", "clock", "cosh", "ctime", "div", "exit", "fabs", "floor", "fmod", "getchar", "getenv", "isalnum", "isalpha", "isdigit", "isgraph",
-			"ispunct", "isspace", "isupper", "kbhit", "log10", "log2", "log", "memcmp", "modf", "pow", "putchar", "putenv", "puts", "rand", "remove", "rename", "sinh", "sqrt", "srand", "strcat", "strcmp", "strerror", "time", "tolower", "toupper"
-		};
-		for (auto& k : identifiers)
-		{
-			Identifier id;
-			id.mDeclaration = "Built-in function";
-			langDef.mIdentifiers.insert(std::make_pair(std::string(k), id));
-		}
-
-		langDef.mTokenRegexStrings.push_back(std::make_pair<std::string, PaletteIndex>("[ \\t]*#[ \\t]*[a-zA-Z_]+", PaletteIndex::Preprocessor));
-		langDef.mTokenRegexStrings.push_back(std::make_pair<std::string, PaletteIndex>("L?\\\"(\\\\.|[^\\\"])*\\\"", PaletteIndex::String));
-		langDef.mTokenRegexStrings.push_back(std::make_pair<std::string, PaletteIndex>("\\'\\\\?[^\\']\\'", PaletteIndex::CharLiteral));
-		langDef.mTokenRegexStrings.push_back(std::make_pair<std::string, PaletteIndex>("[+-]?([0-9]+([.][0-9]*)?|[.][0-9]+)([eE][+-]?[0-9]+)?[fF]?", PaletteIndex::Number));
-		langDef.mTokenRegexStrings.push_back(std::make_pair<std::string, PaletteIndex>("[+-]?[0-9]+[Uu]?[lL]?[lL]?", PaletteIndex::Number));
-		langDef.mTokenRegexStrings.push_back(std::make_pair<std::string, PaletteIndex>("0[0-7]+[Uu]?[lL]?[lL]?", PaletteIndex::Number));
-		langDef.mTokenRegexStrings.push_back(std::make_pair<std::string, PaletteIndex>("0[xX][0-9a-fA-F]+[uU]?[lL]?[lL]?", PaletteIndex::Number));
-		langDef.mTokenRegexStrings.push_back(std::make_pair<std::string, PaletteIndex>("[a-zA-Z_][a-zA-Z0-9_]*", PaletteIndex::Identifier));
-		langDef.mTokenRegexStrings.push_back(std::make_pair<std::string, PaletteIndex>("[\\[\\]\\{\\}\\!\\%\\^\\&\\*\\(\\)\\-\\+\\=\\~\\|\\<\\>\\?\\/\\;\\,\\.]", PaletteIndex::Punctuation));
-
-		langDef.mCommentStart = "/*";
-		langDef.mCommentEnd = "*/";
-		langDef.mSingleLineComment = "//";
-
-		langDef.mCaseSensitive = true;
-		langDef.mAutoIndentation = true;
-
-		langDef.mName = "GLSL";
-
-		inited = true;
-	}
-	return langDef;
-}
-
-const TextEditor::LanguageDefinition& TextEditor::LanguageDefinition::C()
-{
-	static bool inited = false;
-	static LanguageDefinition langDef;
-	if (!inited)
-	{
-		static const char* const keywords[] = {
-			"auto", "break", "case", "char", "const", "continue", "default", "do", "double", "else", "enum", "extern", "float", "for", "goto", "if", "inline", "int", "long", "register", "restrict", "return", "short",
-			"signed", "sizeof", "static", "struct", "switch", "typedef", "union", "unsigned", "void", "volatile", "while", "_Alignas", "_Alignof", "_Atomic", "_Bool", "_Complex", "_Generic", "_Imaginary",
-			"_Noreturn", "_Static_assert", "_Thread_local"
-		};
-		for (auto& k : keywords)
-			langDef.mKeywords.insert(k);
-
-		static const char* const identifiers[] = {
-			"abort", "abs", "acos", "asin", "atan", "atexit", "atof", "atoi", "atol", "ceil", "clock", "cosh", "ctime", "div", "exit", "fabs", "floor", "fmod", "getchar", "getenv", "isalnum", "isalpha", "isdigit", "isgraph",
-			"ispunct", "isspace", "isupper", "kbhit", "log10", "log2", "log", "memcmp", "modf", "pow", "putchar", "putenv", "puts", "rand", "remove", "rename", "sinh", "sqrt", "srand", "strcat", "strcmp", "strerror", "time", "tolower", "toupper"
-		};
-		for (auto& k : identifiers)
-		{
-			Identifier id;
-			id.mDeclaration = "Built-in function";
-			langDef.mIdentifiers.insert(std::make_pair(std::string(k), id));
-		}
-
-		langDef.mTokenize = [](const char * in_begin, const char * in_end, const char *& out_begin, const char *& out_end, PaletteIndex & paletteIndex) -> bool
-		{
-			paletteIndex = PaletteIndex::Max;
-
-			while (in_begin < in_end && isascii(*in_begin) && isblank(*in_begin))
-				in_begin++;
-
-			if (in_begin == in_end)
-			{
-				out_begin = in_end;
-				out_end = in_end;
-				paletteIndex = PaletteIndex::Default;
-			}
-			else if (TokenizeCStyleString(in_begin, in_end, out_begin, out_end))
-				paletteIndex = PaletteIndex::String;
-			else if (TokenizeCStyleCharacterLiteral(in_begin, in_end, out_begin, out_end))
-				paletteIndex = PaletteIndex::CharLiteral;
-			else if (TokenizeCStyleIdentifier(in_begin, in_end, out_begin, out_end))
-				paletteIndex = PaletteIndex::Identifier;
-			else if (TokenizeCStyleNumber(in_begin, in_end, out_begin, out_end))
-				paletteIndex = PaletteIndex::Number;
-			else if (TokenizeCStylePunctuation(in_begin, in_end, out_begin, out_end))
-				paletteIndex = PaletteIndex::Punctuation;
-
-			return paletteIndex != PaletteIndex::Max;
-		};
-
-		langDef.mCommentStart = "/*";
-		langDef.mCommentEnd = "*/";
-		langDef.mSingleLineComment = "//";
-
-		langDef.mCaseSensitive = true;
-		langDef.mAutoIndentation = true;
-
-		langDef.mName = "C";
-
-		inited = true;
-	}
-	return langDef;
-}
-
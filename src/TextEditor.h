@@ -1,6 +1,7 @@
 #pragma once
 
 #include <string>
+#include <string_view>
 #include <vector>
 #include <array>
 #include <memory>
@@ -8,7 +9,14 @@
 #include <unordered_map>
 #include <map>
 #include <regex>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <optional>
 #include "imgui.h"
+#include "LineRope.h"
+#include "TextEditorCompletion.h"
 
 struct SmartSymbol;
 
@@ -140,26 +148,98 @@ public:
 	typedef std::array<ImU32, (unsigned)PaletteIndex::Max> Palette;
 	typedef uint8_t Char;
 
-	struct Glyph
+	// Attributes of one character packed in a byte: the palette index in the low nibble,
+	// comment and preprocessor flags in the high bits
+	typedef uint8_t GlyphAttr;
+
+	enum : GlyphAttr
+	{
+		GlyphColorMask = 0x0f,
+		GlyphComment = 0x10,
+		GlyphMultiLineComment = 0x20,
+		GlyphPreprocessor = 0x40
+	};
+
+	static GlyphAttr MakeGlyphAttr(PaletteIndex aColorIndex) { return (GlyphAttr)aColorIndex & GlyphColorMask; }
+	static PaletteIndex GetGlyphColorIndex(GlyphAttr aAttr) { return (PaletteIndex)(aAttr & GlyphColorMask); }
+
+	// Comment/string lexer state at a line boundary, cached on every line so that
+	// comment tracking can resume from any line instead of the top of the file
+	typedef uint8_t LexState;
+
+	enum : LexState
+	{
+		LexBlockComment = 0x01,
+		LexString = 0x02,
+		LexContinued = 0x04,		// the line ends with '\', the flags below carry over to the next line
+		LexSingleLineComment = 0x08,
+		LexPreproc = 0x10,
+		LexFirstChar = 0x20,
+		LexUnknown = 0xff			// the line has not been scanned yet
+	};
+
+	// A line of text stored as a struct of arrays: the UTF-8 bytes are contiguous so they
+	// can be scanned in place, with one attribute byte per text byte alongside them
+	struct Line
 	{
-		Char mChar;
-		PaletteIndex mColorIndex = PaletteIndex::Default;
-		bool mComment : 1;
-		bool mMultiLineComment : 1;
-		bool mPreprocessor : 1;
-
-		Glyph(Char aChar, PaletteIndex aColorIndex) : mChar(aChar), mColorIndex(aColorIndex),
-			mComment(false), mMultiLineComment(false), mPreprocessor(false) {}
+		std::string mChars;
+		std::vector<GlyphAttr> mAttrs;
+		LexState mLexEntry = LexUnknown;
+		LexState mLexExit = 0;
+
+		// Pixel width measured by the renderer for mWidthGeneration, reset whenever the text changes
+		mutable float mWidth = -1.0f;
+		mutable uint32_t mWidthGeneration = 0;
+
+		Line() {}
+		Line(const char* aBegin, const char* aEnd) : mChars(aBegin, aEnd), mAttrs(mChars.size(), GlyphAttr(0)) {}
+
+		size_t size() const { return mChars.size(); }
+		bool empty() const { return mChars.empty(); }
+		Char operator[](size_t aIndex) const { return (Char)mChars[aIndex]; }
+
+		void push_back(char aChar, GlyphAttr aAttr = 0)
+		{
+			mChars.push_back(aChar);
+			mAttrs.push_back(aAttr);
+			mWidth = -1.0f;
+		}
+
+		void insert(size_t aIndex, char aChar, GlyphAttr aAttr = 0)
+		{
+			mChars.insert(mChars.begin() + aIndex, aChar);
+			mAttrs.insert(mAttrs.begin() + aIndex, aAttr);
+			mWidth = -1.0f;
+		}
+
+		// Inserts the characters [aFrom, aTo) of aOther before aIndex
+		void insert(size_t aIndex, const Line& aOther, size_t aFrom, size_t aTo)
+		{
+			mChars.insert(aIndex, aOther.mChars, aFrom, aTo - aFrom);
+			mAttrs.insert(mAttrs.begin() + aIndex, aOther.mAttrs.begin() + aFrom, aOther.mAttrs.begin() + aTo);
+			mWidth = -1.0f;
+		}
+
+		void append(const Line& aOther) { insert(size(), aOther, 0, aOther.size()); }
+
+		void erase(size_t aFrom, size_t aTo)
+		{
+			mChars.erase(aFrom, aTo - aFrom);
+			mAttrs.erase(mAttrs.begin() + aFrom, mAttrs.begin() + aTo);
+			mWidth = -1.0f;
+		}
+
+		void erase(size_t aIndex) { erase(aIndex, aIndex + 1); }
 	};
 
-	typedef std::vector<Glyph> Line;
-	typedef std::vector<Line> Lines;
+	typedef LineRope<Line> Lines;
 
 	struct LanguageDefinition
 	{
 		typedef std::pair<std::string, PaletteIndex> TokenRegexString;
 		typedef std::vector<TokenRegexString> TokenRegexStrings;
 		typedef bool(*TokenizeCallback)(const char * in_begin, const char * in_end, const char *& out_begin, const char *& out_end, PaletteIndex & paletteIndex);
+		typedef PaletteIndex(*ClassifyCallback)(const char * in_begin, const char * in_end, bool aPreprocessor);
 
 		std::string mName;
 		Keywords mKeywords;
@@ -171,15 +251,24 @@ public:
 
 		TokenizeCallback mTokenize;
 
+		// Classifies an identifier token without allocating, used instead of the keyword and identifier
+		// sets when set. The built-in definitions use tables generated at compile time, so clear this
+		// when changing their keywords.
+		ClassifyCallback mClassify;
+
 		TokenRegexStrings mTokenRegexStrings;
 
 		bool mCaseSensitive;
 
 		LanguageDefinition()
-			: mPreprocChar('#'), mAutoIndentation(true), mTokenize(nullptr), mCaseSensitive(true)
+			: mPreprocChar('#'), mAutoIndentation(true), mTokenize(nullptr), mClassify(nullptr), mCaseSensitive(true)
 		{
 		}
 
+		// Table driven tokenizers used by the built-in definitions, see TextEditorLexer.cpp
+		static bool TokenizeCStyle(const char * in_begin, const char * in_end, const char *& out_begin, const char *& out_end, PaletteIndex & paletteIndex);
+		static bool TokenizeShader(const char * in_begin, const char * in_end, const char *& out_begin, const char *& out_end, PaletteIndex & paletteIndex);
+
 		static const LanguageDefinition& CPlusPlus();
 		static const LanguageDefinition& HLSL();
 		static const LanguageDefinition& GLSL();
@@ -199,7 +288,11 @@ public:
 	void SetBreakpoints(const Breakpoints& aMarkers) { mBreakpoints = aMarkers; }
 
 	void Render(const char* aTitle, const ImVec2& aSize = ImVec2(), bool aBorder = false);
-	void SetText(const std::string& aText);
+	void SetText(std::string_view aText);
+	// Shows aText without copying it, for files too large to edit: the editor turns read-only
+	// with the colorizer off and a line is only loaded the first time it is accessed. aOwner
+	// keeps the memory behind aText alive for as long as the text is shown.
+	void SetTextView(std::string_view aText, std::shared_ptr<const void> aOwner);
 	std::string GetText() const;
 
 	void SetTextLines(const std::vector<std::string>& aLines);
@@ -214,11 +307,19 @@ public:
 	void SetReadOnly(bool aValue);
 	bool IsReadOnly() const { return mReadOnly; }
 	bool IsTextChanged() const { return mTextChanged; }
+	// Moves on every change of the text (and recoloring), usable to cache copies of it
+	uint64_t GetTextVersion() const { return mTextVersion; }
 	bool IsCursorPositionChanged() const { return mCursorPositionChanged; }
 
 	bool IsColorizerEnabled() const { return mColorizerEnabled; }
 	void SetColorizerEnable(bool aValue);
 
+	// Seconds until the editor wants another frame (cursor blink, pending coloring), or a negative
+	// value when nothing changes until the next input.
+	float GetRedrawDelay() const;
+	// Called from the colorizer thread when a result is ready to be applied on the next frame
+	void SetRedrawCallback(std::function<void()> aCallback) { mRedrawCallback = std::move(aCallback); }
+
 	Coordinates GetCursorPosition() const { return GetActualCursorCoordinates(); }
 	void SetCursorPosition(const Coordinates& aPosition);
 
@@ -315,10 +416,28 @@ private:
 
 	typedef std::vector<UndoRecord> UndoBuffer;
 
+	// A copy of a range of lines handed to the colorizer thread
+	struct ColorizeJob
+	{
+		int mFromLine = 0;
+		int mTotalLines = 0;
+		std::vector<Line> mLines;
+	};
+
 	void ProcessInputs();
 	void Colorize(int aFromLine = 0, int aCount = -1);
 	void ColorizeRange(int aFromLine = 0, int aToLine = 0);
 	void ColorizeInternal();
+	LexState ColorizeComments(Line& aLine, LexState aEntryState) const;
+	void ColorizeLine(Line& aLine, std::cmatch& aResults, std::string& aId) const;
+	void ColorizeWorker(std::stop_token aStop);
+	void StartColorizeJob(int aFromLine, int aToLine);
+	void ApplyColorizeResult();
+	void CancelColorizeJob();
+	void UpdateLayoutMetrics();
+	float TextWidth(const char* aBegin, const char* aEnd) const;
+	float TabStop(float aX) const;
+	float GetLineWidth(int aLine) const;
 	float TextDistanceToLineStart(const Coordinates& aFrom) const;
 	void EnsureCursorVisible();
 	int GetPageSize() const;
@@ -341,13 +460,15 @@ private:
 	void RemoveLine(int aStart, int aEnd);
 	void RemoveLine(int aIndex);
 	Line& InsertLine(int aIndex);
+	void InsertLines(int aIndex, std::vector<Line>& aLines);
+	void ShiftColorizeRanges(int aIndex, int aCount);
 	void EnterCharacter(ImWchar aChar, bool aShift);
 	void Backspace();
 	void DeleteSelection();
 	void ReplaceRange(const std::string& replaceWith, const Coordinates& aStart, const Coordinates& aEnd);
 	std::string GetWordUnderCursor() const;
 	std::string GetWordAt(const Coordinates& aCoords) const;
-	ImU32 GetGlyphColor(const Glyph& aGlyph) const;
+	ImU32 GetGlyphColor(GlyphAttr aAttr) const;
 
 	void HandleKeyboardInputs();
 	void HandleMouseInputs();
@@ -362,6 +483,8 @@ private:
 
 	void ResetAutoComplete();
 	void StartAutoComplete(const Coordinates& pos, bool force = false);
+	void PollAutoComplete();
+	void UpdateAutoCompleteMatch();
 	void RenderAutoComplete(const ImVec2& aPosition);
 	void AcceptAutoComplete();
 
@@ -403,7 +526,10 @@ private:
 	Coordinates mAutoCompleteWordEnd;
 	bool mFocusBack = false;
 
-	std::vector<SmartCompletioResult> mAutoCompleteList;
+	CompletionSession mAutoCompleteSession;
+	// Request still being serviced by SmartSense, results are added to the session as they arrive
+	SmartCompletionRequestPtr mAutoCompleteRequest;
+	Coordinates mAutoCompleteRequestStart;
 	int mAutoCompleteBestMatchIndex = -1;
 
 	Palette mPaletteBase;
@@ -412,12 +538,39 @@ private:
 	RegexList mRegexList;
 
 	bool mCheckComments;
+	int mCommentRangeMin, mCommentRangeMax;
+	uint64_t mTextVersion;
+	bool mColorizeInFlight;
+	// Lines no edit touched since the job in flight was taken: the first mColorizeCleanHead
+	// lines and the last mColorizeCleanTail lines of the text
+	int mColorizeCleanHead;
+	int mColorizeCleanTail;
 	Breakpoints mBreakpoints;
 	ErrorMarkers mErrorMarkers;
 	ImVec2 mCharAdvance;
+
+	// Text measurement for the current font, refreshed when the font, its size or the tab size
+	// change. mLayoutGeneration is bumped at the same time so cached line widths become stale.
+	const ImFont* mLayoutFont;
+	float mLayoutFontSize;
+	int mLayoutTabSize;
+	uint32_t mLayoutGeneration;
+	float mSpaceAdvance;
+	std::array<float, 128> mAsciiAdvance;
+	std::array<const ImFontGlyph*, 128> mAsciiGlyphs;
 	Coordinates mInteractiveStart, mInteractiveEnd;
-	std::string mLineBuffer;
 	uint64_t mStartTime;
+	bool mCursorBlinking;
+	std::function<void()> mRedrawCallback;
 
 	float mLastClick;
+
+	// Colorizer thread state, guarded by mColorizeMutex. The thread is declared last so it
+	// is stopped before anything it uses is destroyed.
+	std::mutex mColorizeMutex;
+	std::condition_variable_any mColorizeCondition;
+	std::optional<ColorizeJob> mColorizeJob;
+	std::optional<ColorizeJob> mColorizeResult;
+	bool mColorizeBusy;
+	std::jthread mColorizeThread;
 };
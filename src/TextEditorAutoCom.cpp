@@ -38,7 +38,7 @@ TextEditor::Coordinates TextEditor::FindWordStartAutoComplete(const Coordinates
 		return at;
 	}
 
-	auto rightChar = line[cindex].mChar;
+	auto rightChar = line[cindex];
 
 	if (!(isalpha(rightChar) || rightChar == '_')) {
 		if (endLine) {
@@ -50,10 +50,10 @@ TextEditor::Coordinates TextEditor::FindWordStartAutoComplete(const Coordinates
 	}
 
 	while (cindex > 0) {
-		auto c = line[cindex].mChar;
+		auto c = line[cindex];
 		auto d = UTF8CharLength(c);
 
-		auto prevChar = line[cindex-1].mChar;
+		auto prevChar = line[cindex-1];
 
 		if (!(isalpha(prevChar) || prevChar == '_')) {
 			if (prevChar == '.') {
@@ -81,7 +81,7 @@ TextEditor::Coordinates TextEditor::FindWordEndAutoComplete(const Coordinates &
 
 	while (cindex < (int)line.size())
 	{
-		auto c = line[cindex].mChar;
+		auto c = line[cindex];
 		auto d = UTF8CharLength(c);
 
 		if (!(isalpha(c) || c == '_')) {
@@ -104,7 +104,7 @@ std::string TextEditor::GetWordForAutoComplete(const Coordinates& aCoords) {
 	auto iend = GetCharacterIndex(mAutoCompleteWordEnd);
 
 	for (auto it = istart; it < iend; ++it) {
-		auto c = mLines[aCoords.mLine][it].mChar;
+		auto c = mLines[aCoords.mLine][it];
 		r.push_back(c);
 	}
 
@@ -136,23 +136,23 @@ void TextEditor::RenderAutoComplete(const ImVec2& aPosition) {
     	bool close = false;
     	ImGuiListClipper clipper;
         
-    	clipper.Begin(mAutoCompleteList.size());
+    	clipper.Begin(mAutoCompleteSession.GetMatchCount());
 
     	// Make sure we bring the currently 'active' item into view.
     	if (mAutoCompleteSelectionChanged) {
-    		if (mAutoCompleteBestMatchIndex >= 0 && mAutoCompleteBestMatchIndex < mAutoCompleteList.size()) {
+    		if (mAutoCompleteBestMatchIndex >= 0 && mAutoCompleteBestMatchIndex < mAutoCompleteSession.GetMatchCount()) {
     			clipper.IncludeItemByIndex(mAutoCompleteBestMatchIndex);
     		}
     	}
 
-    	//printf("total %d, start %d, end %d\n", mAutoCompleteList.size(), clipper.DisplayStart, clipper.DisplayEnd);
+    	//printf("total %d, start %d, end %d\n", mAutoCompleteSession.GetMatchCount(), clipper.DisplayStart, clipper.DisplayEnd);
         while (clipper.Step()) {
 	        for (int idx = clipper.DisplayStart; idx < clipper.DisplayEnd; ++idx) {
 
-	        	if (idx >= mAutoCompleteList.size())
+	        	if (idx >= mAutoCompleteSession.GetMatchCount())
 	        		break;
 
-	        	const auto& v = mAutoCompleteList[idx];
+	        	const auto& v = mAutoCompleteSession.GetMatch(idx);
 	    	/*
 	    	for (auto& v : mAutoCompleteList) {
 	    	*/
@@ -216,8 +216,12 @@ void TextEditor::RenderAutoComplete(const ImVec2& aPosition) {
 }
 
 void TextEditor::ResetAutoComplete() {
+	if (mAutoCompleteRequest) {
+		mAutoCompleteRequest->mCancelled = true;
+		mAutoCompleteRequest = nullptr;
+	}
 	mShowAutoComplete = false;
-	mAutoCompleteList.clear();
+	mAutoCompleteSession.Clear();
 	mAutoCompleteWord = "";
 	mAutoCompleteBestMatchIndex = -1;
 	mAutoCompleteSelectionChanged = false;
@@ -226,8 +230,8 @@ void TextEditor::ResetAutoComplete() {
 }
 
 void TextEditor::AcceptAutoComplete() {
-	if (mAutoCompleteBestMatchIndex >= 0 && mAutoCompleteList.size() > 0) {
-		const std::string& bestWord = mAutoCompleteList[mAutoCompleteBestMatchIndex].mName;
+	if (mAutoCompleteBestMatchIndex >= 0 && mAutoCompleteBestMatchIndex < mAutoCompleteSession.GetMatchCount()) {
+		const std::string bestWord = mAutoCompleteSession.GetMatch(mAutoCompleteBestMatchIndex).mName;
 		// Maybe we don't to replace just insert would be good
 		if (mAutoCompleteWordStart == mAutoCompleteWordEnd) {
 			InsertText(bestWord);
@@ -251,73 +255,108 @@ void TextEditor::StartAutoComplete(const Coordinates& pos, bool force) {
 		return;
 	}
 
-	// TODO: Instead of waiting for the whole list to popup
-	// maybe this could be dynamic?? like show while loading??
-	
-	if (!mShowAutoComplete) {	
-		mAutoCompleteList.clear();
+	// Results are the same for every prefix typed after the word start, so a request still in
+	// flight for this word is kept. Anything else is stale and gets cancelled.
+	bool pending = mAutoCompleteRequest && mAutoCompleteRequestStart == mAutoCompleteWordStart;
+
+	if (!mShowAutoComplete && !pending) {
+		if (mAutoCompleteRequest) {
+			mAutoCompleteRequest->mCancelled = true;
+			mAutoCompleteRequest = nullptr;
+		}
+		mAutoCompleteSession.Clear();
 
 		// First, get all the possible completion words
 
 		UIEditorPtr editor = UISystem::get().getEditorManager().getActiveEditor();
 
-		SmartSourceFilePtr smartFile = nullptr;
 		std::shared_ptr<SmartSense> smartSense = PaperCode::get().getSmartSense();
 
 		if (editor && smartSense) {
-			std::string filePath = editor->getFilePath().string();
-			smartFile = smartSense->getDatabase().getFile(filePath);
-
 			CompletionRequestArgs args;
 
-			args.mFilePath = filePath;
-			args.mUnsavedText = editor->mImEditor->GetText();
-			args.mLine = pos.mLine + 1;
-			args.mColumn = pos.mColumn + 1;
+			args.mFilePath = editor->getFilePath().string();
+			args.mUnsaved.mText = editor->getSnapshot(&args.mUnsaved.mVersion);
+			// libclang wants the position right where the word starts, not inside of it
+			args.mLine = mAutoCompleteWordStart.mLine + 1;
+			args.mColumn = GetCharacterIndex(mAutoCompleteWordStart) + 1;
 
-			smartSense->requestCodeCompleteAt(args, mAutoCompleteList);
-
-			// TODO: TOO EXPENSIVE 
-			std::sort(mAutoCompleteList.begin(), mAutoCompleteList.end(), 
-				[](const SmartCompletioResult& s1, const SmartCompletioResult& s2){
-					return s1.mName < s2.mName;
-				});
+			mAutoCompleteRequest = smartSense->requestCodeComplete(std::move(args));
+			mAutoCompleteRequestStart = mAutoCompleteWordStart;
 		}
 	}
 
-	// Now we have a list to match with the word we typed in
-	if (!mAutoCompleteList.empty()) {
+	UpdateAutoCompleteMatch();
+}
+
+void TextEditor::PollAutoComplete() {
+	if (!mAutoCompleteRequest) {
+		return;
+	}
+
+	std::vector<SmartCompletioResult> results;
+	bool done = mAutoCompleteRequest->takeResults(results);
+	bool arrived = !results.empty();
+
+	if (arrived) {
+		mAutoCompleteSession.Append(std::move(results));
+		mAutoCompleteSelectionChanged = true;
+	}
+
+	if (done) {
+		mAutoCompleteRequest = nullptr;
+	}
+
+	if (arrived || done) {
+		UpdateAutoCompleteMatch();
+	}
+}
+
+void TextEditor::UpdateAutoCompleteMatch() {
+	// Narrow the results down to the word we typed in, the best match comes first
+	mAutoCompleteSession.SetPattern(mAutoCompleteWord);
+
+	if (mAutoCompleteSession.GetMatchCount() > 0) {
 
 		if (!mShowAutoComplete) {
 			mShowAutoComplete = true;
 		}
-		if (!mAutoCompleteWord.empty()) {
-			// TODO: TOO EXPENSIVE 
-			int idx = 0;
-			for (auto& v : mAutoCompleteList) {
-				//printf(":%s: == :%s:\n", v.c_str(), mAutoCompleteWord.c_str());
-		  		if (v.mName.starts_with(mAutoCompleteWord)) {
-					mAutoCompleteBestMatchIndex = idx;
-					break;
-				}
-				idx++;
-			}
-		}
-	} else {
+		mAutoCompleteBestMatchIndex = mAutoCompleteWord.empty() ? -1 : 0;
+	} else if (!mAutoCompleteRequest) {
 		ResetAutoComplete();
 	}
 }
 
+// The editors already wait for a typing pause before they hand their text over, SmartSense
+// only waits for the rest of the configured delay
+static std::chrono::milliseconds GetReparseDelay() {
+	auto delay = std::chrono::milliseconds(PaperCode::get().mSettings.mReparseDelay) - UIEditorManager::kSnapshotDelay;
+	return std::max(delay, std::chrono::milliseconds(0));
+}
+
 std::shared_ptr<SmartSense> newSmartSense() {
 	auto sense = std::make_shared<SmartSense>();
+	sense->mStateCallback = [] () { UISystem::get().wakeUp(); };
+	sense->mScanThreads = (unsigned)std::max(PaperCode::get().mSettings.mSmartSenseThreads, 0);
+	sense->mReparseDelay = GetReparseDelay();
+	for (UIEditorPtr editor : UISystem::get().getEditorManager().mEditors) {
+		sense->mPriorityFiles.push_back(editor->getFilePath().string());
+	}
     sense->init();
     return sense;
 }
 
-void notifySmartSense(const std::string& filepath, const std::string& buf) {
+void updateSmartSenseSettings() {
+	auto smartSense = PaperCode::get().getSmartSense();
+	if (smartSense) {
+		smartSense->setReparseDelay(GetReparseDelay());
+	}
+}
+
+void notifySmartSense(const std::string& filepath, uint64_t version, std::shared_ptr<const std::string> text) {
 	auto smartSense = PaperCode::get().getSmartSense();
     if (smartSense) {
-        smartSense->notifyFileModified(filepath, buf);
+        smartSense->notifyFileModified(filepath, { version, std::move(text) });
     }
 }
 
@@ -331,13 +370,20 @@ void drawSmartSenseState() {
 
         SmartSenseState state = smartSense->getState();
 
-        std::string filename_str = std::filesystem::path(smartSense->getCurrentFileName()).filename().string();
-        const char* filename = filename_str.c_str();
+        std::string filenames_str = "";
+        for (const auto& file : smartSense->getParsingFiles()) {
+            if (!filenames_str.empty()) {
+                filenames_str += ", ";
+            }
+            filenames_str += std::filesystem::path(file).filename().string();
+        }
+        const char* filenames = filenames_str.c_str();
 
         if (state == SmartSenseState::FullScanning) { 
-            ImGui::Text("| SmartSense: %s: %s...", "Full scanning", filename);
+            ImGui::Text("| SmartSense: %s (%zu/%zu): %s...", "Full scanning", 
+                smartSense->getScanDone(), smartSense->getScanTotal(), filenames);
         } else if (state == SmartSenseState::QuickScanning) {
-            ImGui::Text("| SmartSense: %s: %s...", "Quick scanning", filename);
+            ImGui::Text("| SmartSense: %s: %s...", "Quick scanning", filenames);
         }
     }
 }
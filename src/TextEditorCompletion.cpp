@@ -0,0 +1,428 @@
+#include "Stdafx.h"
+
+#include <algorithm>
+#include <bit>
+#include <numeric>
+
+#include "TextEditorCompletion.h"
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define COMPLETION_SIMD
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define COMPLETION_SIMD
+#endif
+
+namespace
+{
+	// One bit per letter (case folded), plus one for digits, '_' and anything else. A name can
+	// only match a pattern whose bits are all in its own mask.
+	uint32_t LetterMask(std::string_view aText)
+	{
+		uint32_t mask = 0;
+		for (unsigned char c : aText)
+		{
+			if (c >= 'a' && c <= 'z')
+				mask |= 1u << (c - 'a');
+			else if (c >= 'A' && c <= 'Z')
+				mask |= 1u << (c - 'A');
+			else if (c >= '0' && c <= '9')
+				mask |= 1u << 26;
+			else if (c == '_')
+				mask |= 1u << 27;
+			else
+				mask |= 1u << 28;
+		}
+		return mask;
+	}
+
+	inline char FoldCase(char c)
+	{
+		return (c >= 'A' && c <= 'Z') ? (char)(c - 'A' + 'a') : c;
+	}
+
+	inline bool IsLower(char c) { return c >= 'a' && c <= 'z'; }
+	inline bool IsUpper(char c) { return c >= 'A' && c <= 'Z'; }
+	inline bool IsAlnum(char c) { return IsLower(c) || IsUpper(c) || (c >= '0' && c <= '9'); }
+
+	bool IsWordStart(std::string_view aName, size_t aIndex)
+	{
+		if (aIndex == 0)
+			return true;
+		auto prev = aName[aIndex - 1];
+		auto c = aName[aIndex];
+		return (IsLower(prev) && IsUpper(c)) || (!IsAlnum(prev) && IsAlnum(c));
+	}
+
+	bool IsSubsequence(std::string_view aPattern, std::string_view aName)
+	{
+		size_t n = 0;
+		for (auto c : aPattern)
+		{
+			while (n < aName.size() && FoldCase(aName[n]) != FoldCase(c))
+				++n;
+			if (n++ >= aName.size())
+				return false;
+		}
+		return true;
+	}
+
+	// Appends the indices in [aFrom, aTo) whose mask contains all bits of aMask
+	void Prefilter(const uint32_t* aMasks, uint32_t aFrom, uint32_t aTo, uint32_t aMask, std::vector<uint32_t>& aOut)
+	{
+		auto i = aFrom;
+#if defined(__AVX2__)
+		const __m256i pattern = _mm256_set1_epi32((int)aMask);
+		for (; aTo - i >= 8; i += 8)
+		{
+			auto masks = _mm256_loadu_si256((const __m256i*)(aMasks + i));
+			auto bits = (uint32_t)_mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpeq_epi32(_mm256_and_si256(masks, pattern), pattern)));
+			for (; bits != 0; bits &= bits - 1)
+				aOut.push_back(i + std::countr_zero(bits));
+		}
+#elif defined(COMPLETION_SIMD)
+		const __m128i pattern = _mm_set1_epi32((int)aMask);
+		for (; aTo - i >= 4; i += 4)
+		{
+			auto masks = _mm_loadu_si128((const __m128i*)(aMasks + i));
+			auto bits = (uint32_t)_mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(_mm_and_si128(masks, pattern), pattern)));
+			for (; bits != 0; bits &= bits - 1)
+				aOut.push_back(i + std::countr_zero(bits));
+		}
+#endif
+		for (; i < aTo; ++i)
+			if ((aMasks[i] & aMask) == aMask)
+				aOut.push_back(i);
+	}
+}
+
+void CompletionSession::Clear()
+{
+	mResults.clear();
+	mLetters.clear();
+	mScores.clear();
+	mByName.clear();
+	mFiltered.clear();
+	mMatches.clear();
+	mPattern.clear();
+}
+
+int CompletionSession::Match(uint32_t aIndex)
+{
+	return mScores[aIndex] = FuzzyScore(mPattern, mResults[aIndex].mName);
+}
+
+void CompletionSession::Append(std::vector<SmartCompletioResult>&& aResults)
+{
+	auto first = (uint32_t)mResults.size();
+	for (auto& result : aResults)
+	{
+		mLetters.push_back(LetterMask(result.mName));
+		mResults.push_back(std::move(result));
+	}
+	auto last = (uint32_t)mResults.size();
+	mScores.resize(last, -1);
+
+	std::vector<uint32_t> candidates;
+	Prefilter(mLetters.data(), first, last, LetterMask(mPattern), candidates);
+	for (auto index : candidates)
+		Match(index);
+
+	// Name order is only computed when results arrive, the new batch is merged into it
+	auto byNameLess = [this](uint32_t a, uint32_t b) { return mResults[a].mName < mResults[b].mName; };
+	mByName.resize(last);
+	std::iota(mByName.begin() + first, mByName.end(), first);
+	std::sort(mByName.begin() + first, mByName.end(), byNameLess);
+	std::inplace_merge(mByName.begin(), mByName.begin() + first, mByName.end(), byNameLess);
+
+	mFiltered.clear();
+	for (auto index : mByName)
+		if (mScores[index] >= 0)
+			mFiltered.push_back(index);
+	Rank();
+}
+
+void CompletionSession::SetPattern(const std::string& aPattern)
+{
+	if (aPattern == mPattern)
+		return;
+
+	bool narrowing = !mPattern.empty() && aPattern.starts_with(mPattern);
+	mPattern = aPattern;
+	uint32_t mask = LetterMask(mPattern);
+
+	if (narrowing)
+	{
+		// Whatever matches the longer pattern also matched the shorter one
+		size_t count = 0;
+		for (auto index : mFiltered)
+		{
+			if ((mLetters[index] & mask) != mask)
+				mScores[index] = -1;
+			else if (Match(index) >= 0)
+				mFiltered[count++] = index;
+		}
+		mFiltered.resize(count);
+	}
+	else
+	{
+		std::fill(mScores.begin(), mScores.end(), -1);
+		std::vector<uint32_t> candidates;
+		Prefilter(mLetters.data(), 0, (uint32_t)mResults.size(), mask, candidates);
+		for (auto index : candidates)
+			Match(index);
+
+		mFiltered.clear();
+		for (auto index : mByName)
+			if (mScores[index] >= 0)
+				mFiltered.push_back(index);
+	}
+	Rank();
+}
+
+void CompletionSession::Rank()
+{
+	// Counting sort on the score, best first. mFiltered is in name order and stays so within a score.
+	int maxScore = 0;
+	for (auto index : mFiltered)
+		maxScore = std::max(maxScore, mScores[index]);
+
+	std::vector<uint32_t> start(maxScore + 2, 0);
+	for (auto index : mFiltered)
+		start[maxScore - mScores[index] + 1]++;
+	for (size_t i = 1; i < start.size(); ++i)
+		start[i] += start[i - 1];
+
+	mMatches.resize(mFiltered.size());
+	for (auto index : mFiltered)
+		mMatches[start[maxScore - mScores[index]]++] = index;
+}
+
+int CompletionSession::FuzzyScore(std::string_view aPattern, std::string_view aName)
+{
+	if (aPattern.empty())
+		return 0;
+
+	int score = 0;
+	size_t n = 0;
+	size_t last = std::string_view::npos;
+	for (size_t i = 0; i < aPattern.size(); ++i)
+	{
+		auto c = FoldCase(aPattern[i]);
+		while (n < aName.size() && FoldCase(aName[n]) != c)
+			++n;
+		if (n >= aName.size())
+			return -1;
+
+		// A later word start beats a match in the middle of a word ("fs" in "getFileSize"), as
+		// long as the rest of the pattern still fits after it
+		if (n != last + 1 && !IsWordStart(aName, n))
+		{
+			for (auto k = n + 1; k < aName.size(); ++k)
+			{
+				if (FoldCase(aName[k]) == c && IsWordStart(aName, k) && IsSubsequence(aPattern.substr(i + 1), aName.substr(k + 1)))
+				{
+					n = k;
+					break;
+				}
+			}
+		}
+
+		score += 1;
+		if (aName[n] == aPattern[i])
+			score += 1;
+		if (n == 0)
+			score += 12;
+		else if (IsWordStart(aName, n))
+			score += 8;
+		if (last != std::string_view::npos && n == last + 1)
+			score += 6;
+		else if (last != std::string_view::npos)
+			score -= std::min<int>((int)(n - last - 1), 3);
+
+		last = n++;
+	}
+
+	// Between equally good matches the shorter name wins. Penalties never turn a match into a miss.
+	score -= std::min<int>((int)(aName.size() - aPattern.size()), 8) / 2;
+	return std::max(score, 0);
+}
+
+namespace
+{
+	// Case-insensitive order, the case only decides between names that are otherwise equal
+	int CompareFolded(std::string_view a, std::string_view b)
+	{
+		auto count = std::min(a.size(), b.size());
+		for (size_t i = 0; i < count; ++i)
+		{
+			auto ca = FoldCase(a[i]);
+			auto cb = FoldCase(b[i]);
+			if (ca != cb)
+				return (unsigned char)ca < (unsigned char)cb ? -1 : 1;
+		}
+		return a.size() == b.size() ? 0 : (a.size() < b.size() ? -1 : 1);
+	}
+
+	bool NameLess(std::string_view a, std::string_view b)
+	{
+		auto order = CompareFolded(a, b);
+		return order != 0 ? order < 0 : a < b;
+	}
+}
+
+void SymbolSearch::Build(SmartDatabase& aDatabase)
+{
+	struct Entry
+	{
+		uint32_t mId;
+		std::string_view mName;		// interned, valid for the whole session
+		uint32_t mFile;
+		int mLine;
+		SmartSymbolType mType;
+	};
+
+	std::vector<Entry> entries;
+	mFiles.clear();
+	for (auto& [path, file] : aDatabase.getFiles())
+	{
+		auto symbols = file->getSymbols();
+		if (symbols.empty())
+			continue;
+
+		auto fileIndex = (uint32_t)mFiles.size();
+		mFiles.push_back(path);
+		for (auto& symbol : symbols)
+			entries.push_back({ symbol.mName, symbol.getName(), fileIndex, symbol.mLine, symbol.mType });
+	}
+
+	std::sort(entries.begin(), entries.end(), [this](const Entry& a, const Entry& b) {
+		if (a.mId != b.mId)
+			return NameLess(a.mName, b.mName);
+		if (a.mFile != b.mFile)
+			return mFiles[a.mFile] < mFiles[b.mFile];
+		return a.mLine < b.mLine;
+	});
+
+	mPool.clear();
+	mNameStart.clear();
+	mLetters.clear();
+	mFirstSymbol.clear();
+	mSymbols.clear();
+	mSymbols.reserve(entries.size());
+	for (size_t i = 0; i < entries.size(); ++i)
+	{
+		// Entries with the same name are next to each other, the name is only stored once
+		auto& entry = entries[i];
+		if (i == 0 || entries[i - 1].mId != entry.mId)
+		{
+			mNameStart.push_back((uint32_t)mPool.size());
+			mLetters.push_back(LetterMask(entry.mName));
+			mFirstSymbol.push_back((uint32_t)mSymbols.size());
+			mPool += entry.mName;
+		}
+		mSymbols.push_back({ (uint32_t)mLetters.size() - 1, entry.mFile, entry.mLine, entry.mType });
+	}
+	mNameStart.push_back((uint32_t)mPool.size());
+	mFirstSymbol.push_back((uint32_t)mSymbols.size());
+
+	mPattern.clear();
+	mScores.assign(mLetters.size(), 0);
+	mFiltered.resize(mLetters.size());
+	std::iota(mFiltered.begin(), mFiltered.end(), 0);
+}
+
+std::string_view SymbolSearch::GetNameAt(uint32_t aName) const
+{
+	return std::string_view(mPool).substr(mNameStart[aName], mNameStart[aName + 1] - mNameStart[aName]);
+}
+
+void SymbolSearch::FindPrefix(std::string_view aPrefix, size_t aLimit, std::vector<uint32_t>& aOut) const
+{
+	aOut.clear();
+	if (mLetters.empty())
+		return;
+
+	// Names are in case-insensitive order, the ones starting with the prefix are a contiguous range
+	auto nameCount = (uint32_t)mLetters.size();
+	auto comparePrefix = [this, aPrefix](uint32_t aName) {
+		return CompareFolded(GetNameAt(aName).substr(0, aPrefix.size()), aPrefix);
+	};
+
+	uint32_t first = 0, count = nameCount;
+	while (count > 0)
+	{
+		auto step = count / 2;
+		if (comparePrefix(first + step) < 0)
+		{
+			first += step + 1;
+			count -= step + 1;
+		}
+		else
+			count = step;
+	}
+	for (auto name = first; name < nameCount && aOut.size() < aLimit && comparePrefix(name) == 0; ++name)
+		for (auto symbol = mFirstSymbol[name]; symbol < mFirstSymbol[name + 1] && aOut.size() < aLimit; ++symbol)
+			aOut.push_back(symbol);
+}
+
+void SymbolSearch::Search(const std::string& aPattern, size_t aLimit, std::vector<uint32_t>& aOut)
+{
+	aOut.clear();
+
+	if (aPattern != mPattern)
+	{
+		bool narrowing = !mPattern.empty() && aPattern.starts_with(mPattern);
+		mPattern = aPattern;
+		uint32_t mask = LetterMask(mPattern);
+
+		if (narrowing)
+		{
+			size_t count = 0;
+			for (auto name : mFiltered)
+			{
+				if ((mLetters[name] & mask) == mask && (mScores[name] = CompletionSession::FuzzyScore(mPattern, GetNameAt(name))) >= 0)
+					mFiltered[count++] = name;
+				else
+					mScores[name] = -1;
+			}
+			mFiltered.resize(count);
+		}
+		else
+		{
+			std::fill(mScores.begin(), mScores.end(), -1);
+			std::vector<uint32_t> candidates;
+			Prefilter(mLetters.data(), 0, (uint32_t)mLetters.size(), mask, candidates);
+
+			mFiltered.clear();
+			for (auto name : candidates)
+				if ((mScores[name] = CompletionSession::FuzzyScore(mPattern, GetNameAt(name))) >= 0)
+					mFiltered.push_back(name);
+		}
+	}
+
+	// Every name has at least one symbol, so the best aLimit names are all that can be shown. The
+	// lowest score that makes it is found from a histogram, only those names are sorted.
+	int maxScore = 0;
+	for (auto name : mFiltered)
+		maxScore = std::max(maxScore, mScores[name]);
+
+	std::vector<size_t> histogram(maxScore + 1, 0);
+	for (auto name : mFiltered)
+		histogram[mScores[name]]++;
+
+	int minScore = maxScore;
+	for (size_t count = histogram[maxScore]; count < aLimit && minScore > 0; count += histogram[--minScore])
+		;
+
+	std::vector<uint32_t> best;
+	for (auto name : mFiltered)
+		if (mScores[name] >= minScore)
+			best.push_back(name);
+	std::stable_sort(best.begin(), best.end(), [this](uint32_t a, uint32_t b) { return mScores[a] > mScores[b]; });
+
+	for (size_t i = 0; i < best.size() && aOut.size() < aLimit; ++i)
+		for (auto symbol = mFirstSymbol[best[i]]; symbol < mFirstSymbol[best[i] + 1] && aOut.size() < aLimit; ++symbol)
+			aOut.push_back(symbol);
+}
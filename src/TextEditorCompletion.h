@@ -0,0 +1,87 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <cstdint>
+
+import smartsense;
+
+// Results of one completion request, narrowed while the word being completed grows. A pattern
+// that extends the previous one only re-checks the current matches, any other pattern starts
+// over from all results with a prefilter on the letters each name contains. Names are sorted once
+// when results arrive, ranking is a counting sort on the scores, so a keystroke never sorts or
+// compares the names themselves.
+class CompletionSession
+{
+public:
+	void Clear();
+	bool IsEmpty() const { return mResults.empty(); }
+
+	// Adds results that arrived for the request and matches them against the current pattern
+	void Append(std::vector<SmartCompletioResult>&& aResults);
+	void SetPattern(const std::string& aPattern);
+	const std::string& GetPattern() const { return mPattern; }
+
+	// Matches, best first. All results in name order while the pattern is empty.
+	int GetMatchCount() const { return (int)mMatches.size(); }
+	const SmartCompletioResult& GetMatch(int aIndex) const { return mResults[mMatches[aIndex]]; }
+
+	// Score of aPattern as a case-insensitive subsequence of aName, -1 if it isn't one. Matches on
+	// the first character, on word starts ('_' separated or camelCase) and in runs score higher.
+	static int FuzzyScore(std::string_view aPattern, std::string_view aName);
+
+private:
+	int Match(uint32_t aIndex);
+	void Rank();
+
+	std::vector<SmartCompletioResult> mResults;
+	std::vector<uint32_t> mLetters;		// letter mask of every result name
+	std::vector<int> mScores;			// score of every result for mPattern, -1 if it doesn't match
+	std::vector<uint32_t> mByName;		// all results in name order
+	std::vector<uint32_t> mFiltered;	// results matching mPattern in name order
+	std::vector<uint32_t> mMatches;		// the same ranked by score, stable in name order
+	std::string mPattern;
+};
+
+// Every symbol of the project for quick-open. Distinct names are interned once in a pool and
+// sorted case-insensitively, so a prefix is a binary search away, and carry the letter mask the
+// fuzzy search prefilters on. Like CompletionSession, a pattern that extends the previous one
+// only re-checks the names that matched it.
+class SymbolSearch
+{
+public:
+	struct Symbol
+	{
+		uint32_t mName;		// index of the interned name
+		uint32_t mFile;		// index into the file paths
+		int mLine;			// 1 based
+		SmartSymbolType mType;
+	};
+
+	void Build(SmartDatabase& aDatabase);
+
+	// Up to aLimit symbols whose name starts with aPrefix, ignoring case, in name order
+	void FindPrefix(std::string_view aPrefix, size_t aLimit, std::vector<uint32_t>& aOut) const;
+	// Up to aLimit symbols whose name fuzzy matches aPattern, best first. All in name order while the pattern is empty.
+	void Search(const std::string& aPattern, size_t aLimit, std::vector<uint32_t>& aOut);
+
+	size_t GetSymbolCount() const { return mSymbols.size(); }
+	const Symbol& GetSymbol(uint32_t aIndex) const { return mSymbols[aIndex]; }
+	std::string_view GetName(const Symbol& aSymbol) const { return GetNameAt(aSymbol.mName); }
+	const std::string& GetFile(const Symbol& aSymbol) const { return mFiles[aSymbol.mFile]; }
+
+private:
+	std::string_view GetNameAt(uint32_t aName) const;
+
+	std::string mPool;					// distinct names back to back, in name order
+	std::vector<uint32_t> mNameStart;	// where each name starts in mPool, one extra for the end
+	std::vector<uint32_t> mLetters;		// letter mask of every name
+	std::vector<uint32_t> mFirstSymbol;	// symbols are grouped by name, one extra for the end
+	std::vector<Symbol> mSymbols;
+	std::vector<std::string> mFiles;
+
+	std::string mPattern;
+	std::vector<uint32_t> mFiltered;	// names matching mPattern, in name order
+	std::vector<int> mScores;			// score of every name for mPattern, -1 if it doesn't match
+};
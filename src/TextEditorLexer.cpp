@@ -0,0 +1,560 @@
+#include "Stdafx.h"
+
+#include <array>
+#include <bit>
+#include <string_view>
+
+#include "TextEditor.h"
+
+// Hand written tokenizer and keyword tables for the built-in language definitions. Every character
+// is classified with a single lookup in a table generated at compile time, so a token is found with
+// one switch instead of trying a list of std::regex or tokenizer functions in turn. Identifiers are
+// then looked up in a hash table that is also built at compile time.
+
+namespace
+{
+	enum CharClass : uint8_t
+	{
+		CharOther,
+		CharBlank,
+		CharIdentifier,
+		CharDigit,
+		CharSign,
+		CharQuote,
+		CharApostrophe,
+		CharPunctuation,
+		CharHash
+	};
+
+	enum CharFlags : uint8_t
+	{
+		FlagIdentifier = 0x01,	// may continue an identifier
+		FlagDigit = 0x02,
+		FlagHexDigit = 0x04
+	};
+
+	struct CharTable
+	{
+		CharClass mClass[256];
+		uint8_t mFlags[256];
+	};
+
+	constexpr CharTable MakeCharTable(std::string_view aPunctuation)
+	{
+		CharTable table{};
+		for (int c = 0; c < 256; ++c)
+		{
+			auto isLower = c >= 'a' && c <= 'z';
+			auto isUpper = c >= 'A' && c <= 'Z';
+			auto isDigit = c >= '0' && c <= '9';
+
+			auto cls = CharOther;
+			if (c == ' ' || c == '\t')
+				cls = CharBlank;
+			else if (isLower || isUpper || c == '_')
+				cls = CharIdentifier;
+			else if (isDigit)
+				cls = CharDigit;
+			else if (c == '+' || c == '-')
+				cls = CharSign;
+			else if (c == '"')
+				cls = CharQuote;
+			else if (c == '\'')
+				cls = CharApostrophe;
+			else if (c == '#')
+				cls = CharHash;
+			else if (aPunctuation.find((char)c) != std::string_view::npos)
+				cls = CharPunctuation;
+			table.mClass[c] = cls;
+
+			uint8_t flags = 0;
+			if (isLower || isUpper || isDigit || c == '_')
+				flags |= FlagIdentifier;
+			if (isDigit)
+				flags |= FlagDigit;
+			if (isDigit || (c >= 'a' && c <= 'f') || (c >= 'A' && c <= 'F'))
+				flags |= FlagHexDigit;
+			table.mFlags[c] = flags;
+		}
+		return table;
+	}
+
+	constexpr CharTable kCStyleTable = MakeCharTable("[]{}!%^&*()-+=~|<>?:/;,.");
+	constexpr CharTable kShaderTable = MakeCharTable("[]{}!%^&*()-+=~|<>?/;,.");
+
+	inline CharClass ClassOf(const CharTable& aTable, char c)
+	{
+		return aTable.mClass[(uint8_t)c];
+	}
+
+	inline bool HasFlag(const CharTable& aTable, char c, uint8_t aFlag)
+	{
+		return (aTable.mFlags[(uint8_t)c] & aFlag) != 0;
+	}
+
+	const char* ScanString(const char* p, const char* in_end)
+	{
+		// p is on the opening quote, returns the end of the literal or nullptr if it is not closed
+		for (++p; p < in_end; ++p)
+		{
+			if (*p == '"')
+				return p + 1;
+			if (*p == '\\' && p + 1 < in_end)
+				++p;
+		}
+		return nullptr;
+	}
+
+	const char* ScanCharacterLiteral(const char* p, const char* in_end)
+	{
+		++p;
+		if (p < in_end && *p == '\\')
+			p++;
+		if (p < in_end)
+			p++;
+		if (p < in_end && *p == '\'')
+			return p + 1;
+		return nullptr;
+	}
+
+	const char* ScanNumber(const CharTable& aTable, const char* p, const char* in_end)
+	{
+		auto hasNumber = HasFlag(aTable, *p, FlagDigit);
+		for (++p; p < in_end && HasFlag(aTable, *p, FlagDigit); ++p)
+			hasNumber = true;
+
+		if (!hasNumber)
+			return nullptr;
+
+		auto isFloat = false;
+		auto isHexOrBinary = false;
+
+		if (p < in_end)
+		{
+			if (*p == '.')
+			{
+				isFloat = true;
+				for (++p; p < in_end && HasFlag(aTable, *p, FlagDigit); ++p)
+					;
+			}
+			else if (*p == 'x' || *p == 'X')
+			{
+				isHexOrBinary = true;
+				for (++p; p < in_end && HasFlag(aTable, *p, FlagHexDigit); ++p)
+					;
+			}
+			else if (*p == 'b' || *p == 'B')
+			{
+				isHexOrBinary = true;
+				for (++p; p < in_end && (*p == '0' || *p == '1'); ++p)
+					;
+			}
+		}
+
+		if (!isHexOrBinary)
+		{
+			// floating point exponent
+			if (p < in_end && (*p == 'e' || *p == 'E'))
+			{
+				isFloat = true;
+
+				p++;
+				if (p < in_end && (*p == '+' || *p == '-'))
+					p++;
+
+				auto hasDigits = false;
+				for (; p < in_end && HasFlag(aTable, *p, FlagDigit); ++p)
+					hasDigits = true;
+
+				if (!hasDigits)
+					return nullptr;
+			}
+
+			// single precision floating point type
+			if (p < in_end && (*p == 'f' || *p == 'F'))
+				p++;
+		}
+
+		if (!isFloat)
+		{
+			// integer size type
+			while (p < in_end && (*p == 'u' || *p == 'U' || *p == 'l' || *p == 'L'))
+				p++;
+		}
+
+		return p;
+	}
+
+	template<const CharTable& Table, bool Directives>
+	bool Tokenize(const char * in_begin, const char * in_end, const char *& out_begin, const char *& out_end, TextEditor::PaletteIndex & paletteIndex)
+	{
+		using PaletteIndex = TextEditor::PaletteIndex;
+
+		while (in_begin < in_end && ClassOf(Table, *in_begin) == CharBlank)
+			in_begin++;
+
+		out_begin = in_begin;
+
+		if (in_begin == in_end)
+		{
+			out_end = in_end;
+			paletteIndex = PaletteIndex::Default;
+			return true;
+		}
+
+		const char* p = in_begin;
+		const char* end = nullptr;
+
+		switch (ClassOf(Table, *p))
+		{
+		case CharQuote:
+			end = ScanString(p, in_end);
+			paletteIndex = PaletteIndex::String;
+			break;
+
+		case CharApostrophe:
+			end = ScanCharacterLiteral(p, in_end);
+			paletteIndex = PaletteIndex::CharLiteral;
+			break;
+
+		case CharIdentifier:
+			if (*p == 'L' && p + 1 < in_end && p[1] == '"')
+			{
+				end = ScanString(p + 1, in_end);
+				paletteIndex = PaletteIndex::String;
+				if (end != nullptr)
+					break;
+			}
+			for (++p; p < in_end && HasFlag(Table, *p, FlagIdentifier); ++p)
+				;
+			end = p;
+			paletteIndex = PaletteIndex::Identifier;
+			break;
+
+		case CharDigit:
+			end = ScanNumber(Table, p, in_end);
+			paletteIndex = PaletteIndex::Number;
+			break;
+
+		case CharSign:
+			end = ScanNumber(Table, p, in_end);
+			paletteIndex = PaletteIndex::Number;
+			if (end == nullptr)
+			{
+				end = p + 1;
+				paletteIndex = PaletteIndex::Punctuation;
+			}
+			break;
+
+		case CharPunctuation:
+			end = p + 1;
+			paletteIndex = PaletteIndex::Punctuation;
+			break;
+
+		case CharHash:
+			// "#  directive" is one preprocessor token
+			if (Directives)
+			{
+				for (++p; p < in_end && ClassOf(Table, *p) == CharBlank; ++p)
+					;
+				auto name = p;
+				for (; p < in_end && ClassOf(Table, *p) == CharIdentifier; ++p)
+					;
+				if (p != name)
+					end = p;
+				paletteIndex = PaletteIndex::Preprocessor;
+			}
+			break;
+
+		default:
+			break;
+		}
+
+		if (end == nullptr)
+			return false;
+
+		out_end = end;
+		return true;
+	}
+
+	struct KeywordSlot
+	{
+		std::string_view mName;
+		TextEditor::PaletteIndex mColor = TextEditor::PaletteIndex::Identifier;
+	};
+
+	constexpr uint32_t HashKeyword(std::string_view aName)
+	{
+		// FNV-1a
+		uint32_t hash = 2166136261u;
+		for (auto c : aName)
+			hash = (hash ^ (uint8_t)c) * 16777619u;
+		return hash;
+	}
+
+	// Open addressed hash table filled at compile time. It is kept at most a quarter full, so
+	// a lookup is a hash, a length check and usually a single string compare.
+	template<size_t Size>
+	struct KeywordTable
+	{
+		static_assert(std::has_single_bit(Size));
+
+		std::array<KeywordSlot, Size> mSlots{};
+		size_t mMinLength = ~size_t(0);
+		size_t mMaxLength = 0;
+		size_t mMaxProbe = 0;
+
+		constexpr void Add(std::string_view aName, TextEditor::PaletteIndex aColor)
+		{
+			auto i = HashKeyword(aName) & (Size - 1);
+			for (size_t probe = 0; ; ++probe, i = (i + 1) & (Size - 1))
+			{
+				// words listed twice keep the color they were first added with
+				if (mSlots[i].mName == aName)
+					return;
+				if (mSlots[i].mName.empty())
+				{
+					mSlots[i] = { aName, aColor };
+					mMaxProbe = std::max(mMaxProbe, probe);
+					break;
+				}
+			}
+			mMinLength = std::min(mMinLength, aName.size());
+			mMaxLength = std::max(mMaxLength, aName.size());
+		}
+
+		constexpr TextEditor::PaletteIndex Find(std::string_view aName) const
+		{
+			if (aName.size() < mMinLength || aName.size() > mMaxLength)
+				return TextEditor::PaletteIndex::Identifier;
+
+			auto i = HashKeyword(aName) & (Size - 1);
+			for (size_t probe = 0; probe <= mMaxProbe; ++probe, i = (i + 1) & (Size - 1))
+			{
+				auto& slot = mSlots[i];
+				if (slot.mName.empty())
+					break;
+				if (slot.mName == aName)
+					return slot.mColor;
+			}
+			return TextEditor::PaletteIndex::Identifier;
+		}
+	};
+
+	constexpr size_t KeywordTableSize(size_t aWords)
+	{
+		return std::bit_ceil(aWords * 4);
+	}
+
+	template<size_t Size, size_t KeywordCount, size_t IdentifierCount>
+	constexpr KeywordTable<Size> MakeKeywordTable(const std::array<std::string_view, KeywordCount>& aKeywords, const std::array<std::string_view, IdentifierCount>& aIdentifiers)
+	{
+		KeywordTable<Size> table;
+		for (auto k : aKeywords)
+			table.Add(k, TextEditor::PaletteIndex::Keyword);
+		for (auto k : aIdentifiers)
+			table.Add(k, TextEditor::PaletteIndex::KnownIdentifier);
+		return table;
+	}
+
+	template<const auto& Table>
+	TextEditor::PaletteIndex Classify(const char * in_begin, const char * in_end, bool aPreprocessor)
+	{
+		// the built-in definitions have no preprocessor identifiers
+		if (aPreprocessor)
+			return TextEditor::PaletteIndex::Identifier;
+		return Table.Find(std::string_view(in_begin, in_end - in_begin));
+	}
+
+	template<size_t KeywordCount, size_t IdentifierCount>
+	void AddWords(TextEditor::LanguageDefinition& aLangDef, const std::array<std::string_view, KeywordCount>& aKeywords, const std::array<std::string_view, IdentifierCount>& aIdentifiers)
+	{
+		// The sets are not used for coloring the built-in definitions but stay filled for callers that read them
+		for (auto k : aKeywords)
+			aLangDef.mKeywords.insert(std::string(k));
+
+		for (auto k : aIdentifiers)
+		{
+			TextEditor::Identifier id;
+			id.mDeclaration = "Built-in function";
+			aLangDef.mIdentifiers.insert(std::make_pair(std::string(k), id));
+		}
+	}
+
+	constexpr auto kCppKeywords = std::to_array<std::string_view>({
+		"alignas", "alignof", "and", "and_eq", "asm", "atomic_cancel", "atomic_commit", "atomic_noexcept", "auto", "bitand", "bitor", "bool", "break", "case", "catch", "char", "char16_t", "char32_t", "class",
+		"compl", "concept", "const", "constexpr", "const_cast", "continue", "decltype", "default", "delete", "do", "double", "dynamic_cast", "else", "enum", "explicit", "export", "extern", "false", "float",
+		"for", "friend", "goto", "if", "import", "inline", "int", "long", "module", "mutable", "namespace", "new", "noexcept", "not", "not_eq", "nullptr", "operator", "or", "or_eq", "private", "protected", "public",
+		"register", "reinterpret_cast", "requires", "return", "short", "signed", "sizeof", "static", "static_assert", "static_cast", "struct", "switch", "synchronized", "template", "this", "thread_local",
+		"throw", "true", "try", "typedef", "typeid", "typename", "union", "unsigned", "using", "virtual", "void", "volatile", "wchar_t", "while", "xor", "xor_eq", "include", "define"
+	});
+
+	constexpr auto kCppIdentifiers = std::to_array<std::string_view>({
+		"abort", "abs", "acos", "asin", "atan", "atexit", "atof", "atoi", "atol", "ceil", "clock", "cosh", "ctime", "div", "exit", "fabs", "floor", "fmod", "getchar", "getenv", "isalnum", "isalpha", "isdigit", "isgraph",
+		"ispunct", "isspace", "isupper", "kbhit", "log10", "log2", "log", "memcmp", "modf", "pow", "printf", "sprintf", "snprintf", "putchar", "putenv", "puts", "rand", "remove", "rename", "sinh", "sqrt", "srand", "strcat", "strcmp", "strerror", "time", "tolower", "toupper",
+		"std", "string", "vector", "map", "unordered_map", "set", "unordered_set", "min", "max"
+	});
+
+	constexpr auto kHlslKeywords = std::to_array<std::string_view>({
+		"AppendStructuredBuffer", "asm", "asm_fragment", "BlendState", "bool", "break", "Buffer", "ByteAddressBuffer", "case", "cbuffer", "centroid", "class", "column_major", "compile", "compile_fragment",
+		"CompileShader", "const", "continue", "ComputeShader", "ConsumeStructuredBuffer", "default", "DepthStencilState", "DepthStencilView", "discard", "do", "double", "DomainShader", "dword", "else",
+		"export", "extern", "false", "float", "for", "fxgroup", "GeometryShader", "groupshared", "half", "Hullshader", "if", "in", "inline", "inout", "InputPatch", "int", "interface", "line", "lineadj",
+		"linear", "LineStream", "matrix", "min16float", "min10float", "min16int", "min12int", "min16uint", "namespace", "nointerpolation", "noperspective", "NULL", "out", "OutputPatch", "packoffset",
+		"pass", "pixelfragment", "PixelShader", "point", "PointStream", "precise", "RasterizerState", "RenderTargetView", "return", "register", "row_major", "RWBuffer", "RWByteAddressBuffer", "RWStructuredBuffer",
+		"RWTexture1D", "RWTexture1DArray", "RWTexture2D", "RWTexture2DArray", "RWTexture3D", "sample", "sampler", "SamplerState", "SamplerComparisonState", "shared", "snorm", "stateblock", "stateblock_state",
+		"static", "string", "struct", "switch", "StructuredBuffer", "tbuffer", "technique", "technique10", "technique11", "texture", "Texture1D", "Texture1DArray", "Texture2D", "Texture2DArray", "Texture2DMS",
+		"Texture2DMSArray", "Texture3D", "TextureCube", "TextureCubeArray", "true", "typedef", "triangle", "triangleadj", "TriangleStream", "uint", "uniform", "unorm", "unsigned", "vector", "vertexfragment",
+		"VertexShader", "void", "volatile", "while",
+		"bool1","bool2","bool3","bool4","double1","double2","double3","double4", "float1", "float2", "float3", "float4", "int1", "int2", "int3", "int4", "in", "out", "inout",
+		"uint1", "uint2", "uint3", "uint4", "dword1", "dword2", "dword3", "dword4", "half1", "half2", "half3", "half4",
+		"float1x1","float2x1","float3x1","float4x1","float1x2","float2x2","float3x2","float4x2",
+		"float1x3","float2x3","float3x3","float4x3","float1x4","float2x4","float3x4","float4x4",
+		"half1x1","half2x1","half3x1","half4x1","half1x2","half2x2","half3x2","half4x2",
+		"half1x3","half2x3","half3x3","half4x3","half1x4","half2x4","half3x4","half4x4",
+	});
+
+	constexpr auto kHlslIdentifiers = std::to_array<std::string_view>({
+		"abort", "abs", "acos", "all", "AllMemoryBarrier", "AllMemoryBarrierWithGroupSync", "any", "asdouble", "asfloat", "asin", "asint", "asint", "asuint",
+		"asuint", "atan", "atan2", "ceil", "CheckAccessFullyMapped", "clamp", "clip", "cos", "cosh", "countbits", "cross", "D3DCOLORtoUBYTE4", "ddx",
+		"ddx_coarse", "ddx_fine", "ddy", "ddy_coarse", "ddy_fine", "degrees", "determinant", "DeviceMemoryBarrier", "DeviceMemoryBarrierWithGroupSync",
+		"distance", "dot", "dst", "errorf", "EvaluateAttributeAtCentroid", "EvaluateAttributeAtSample", "EvaluateAttributeSnapped", "exp", "exp2",
+		"f16tof32", "f32tof16", "faceforward", "firstbithigh", "firstbitlow", "floor", "fma", "fmod", "frac", "frexp", "fwidth", "GetRenderTargetSampleCount",
+		"GetRenderTargetSamplePosition", "GroupMemoryBarrier", "GroupMemoryBarrierWithGroupSync", "InterlockedAdd", "InterlockedAnd", "InterlockedCompareExchange",
+		"InterlockedCompareStore", "InterlockedExchange", "InterlockedMax", "InterlockedMin", "InterlockedOr", "InterlockedXor", "isfinite", "isinf", "isnan",
+		"ldexp", "length", "lerp", "lit", "log", "log10", "log2", "mad", "max", "min", "modf", "msad4", "mul", "noise", "normalize", "pow", "printf",
+		"Process2DQuadTessFactorsAvg", "Process2DQuadTessFactorsMax", "Process2DQuadTessFactorsMin", "ProcessIsolineTessFactors", "ProcessQuadTessFactorsAvg",
+		"ProcessQuadTessFactorsMax", "ProcessQuadTessFactorsMin", "ProcessTriTessFactorsAvg", "ProcessTriTessFactorsMax", "ProcessTriTessFactorsMin",
+		"radians", "rcp", "reflect", "refract", "reversebits", "round", "rsqrt", "saturate", "sign", "sin", "sincos", "sinh", "smoothstep", "sqrt", "step",
+		"tan", "tanh", "tex1D", "tex1D", "tex1Dbias", "tex1Dgrad", "tex1Dlod", "tex1Dproj", "tex2D", "tex2D", "tex2Dbias", "tex2Dgrad", "tex2Dlod", "tex2Dproj",
+		"tex3D", "tex3D", "tex3Dbias", "tex3Dgrad", "tex3Dlod", "tex3Dproj", "texCUBE", "texCUBE", "texCUBEbias", "texCUBEgrad", "texCUBElod", "texCUBEproj", "transpose", "trunc"
+	});
+
+	// GLSL still uses the C word lists
+	constexpr auto kCKeywords = std::to_array<std::string_view>({
+		"auto", "break", "case", "char", "const", "continue", "default", "do", "double", "else", "enum", "extern", "float", "for", "goto", "if", "inline", "int", "long", "register", "restrict", "return", "short",
+		"signed", "sizeof", "static", "struct", "switch", "typedef", "union", "unsigned", "void", "volatile", "while", "_Alignas", "_Alignof", "_Atomic", "_Bool", "_Complex", "_Generic", "_Imaginary",
+		"_Noreturn", "_Static_assert", "_Thread_local"
+	});
+
+	constexpr auto kCIdentifiers = std::to_array<std::string_view>({
+		"abort", "abs", "acos", "asin", "atan", "atexit", "atof", "atoi", "atol", "ceil", "clock", "cosh", "ctime", "div", "exit", "fabs", "floor", "fmod", "getchar", "getenv", "isalnum", "isalpha", "isdigit", "isgraph",
+		"ispunct", "isspace", "isupper", "kbhit", "log10", "log2", "log", "memcmp", "modf", "pow", "putchar", "putenv", "puts", "rand", "remove", "rename", "sinh", "sqrt", "srand", "strcat", "strcmp", "strerror", "time", "tolower", "toupper"
+	});
+
+	constexpr auto kCppWords = MakeKeywordTable<KeywordTableSize(kCppKeywords.size() + kCppIdentifiers.size())>(kCppKeywords, kCppIdentifiers);
+	constexpr auto kHlslWords = MakeKeywordTable<KeywordTableSize(kHlslKeywords.size() + kHlslIdentifiers.size())>(kHlslKeywords, kHlslIdentifiers);
+	constexpr auto kCWords = MakeKeywordTable<KeywordTableSize(kCKeywords.size() + kCIdentifiers.size())>(kCKeywords, kCIdentifiers);
+
+	static_assert(kCppWords.mMaxProbe <= 4 && kHlslWords.mMaxProbe <= 4 && kCWords.mMaxProbe <= 4, "keyword tables collide too often, change the hash or grow them");
+	static_assert(kCppWords.Find("constexpr") == TextEditor::PaletteIndex::Keyword && kCppWords.Find("printf") == TextEditor::PaletteIndex::KnownIdentifier);
+}
+
+bool TextEditor::LanguageDefinition::TokenizeCStyle(const char * in_begin, const char * in_end, const char *& out_begin, const char *& out_end, PaletteIndex & paletteIndex)
+{
+	return Tokenize<kCStyleTable, false>(in_begin, in_end, out_begin, out_end, paletteIndex);
+}
+
+bool TextEditor::LanguageDefinition::TokenizeShader(const char * in_begin, const char * in_end, const char *& out_begin, const char *& out_end, PaletteIndex & paletteIndex)
+{
+	return Tokenize<kShaderTable, true>(in_begin, in_end, out_begin, out_end, paletteIndex);
+}
+
+const TextEditor::LanguageDefinition& TextEditor::LanguageDefinition::CPlusPlus()
+{
+	static bool inited = false;
+	static LanguageDefinition langDef;
+	if (!inited)
+	{
+		AddWords(langDef, kCppKeywords, kCppIdentifiers);
+
+		langDef.mTokenize = &TokenizeCStyle;
+		langDef.mClassify = &Classify<kCppWords>;
+
+		langDef.mCommentStart = "/*";
+		langDef.mCommentEnd = "*/";
+		langDef.mSingleLineComment = "//";
+
+		langDef.mCaseSensitive = true;
+		langDef.mAutoIndentation = true;
+
+		langDef.mName = "C++";
+
+		inited = true;
+	}
+	return langDef;
+}
+
+const TextEditor::LanguageDefinition& TextEditor::LanguageDefinition::HLSL()
+{
+	static bool inited = false;
+	static LanguageDefinition langDef;
+	if (!inited)
+	{
+		AddWords(langDef, kHlslKeywords, kHlslIdentifiers);
+
+		langDef.mTokenize = &TokenizeShader;
+		langDef.mClassify = &Classify<kHlslWords>;
+
+		langDef.mCommentStart = "/*";
+		langDef.mCommentEnd = "*/";
+		langDef.mSingleLineComment = "//";
+
+		langDef.mCaseSensitive = true;
+		langDef.mAutoIndentation = true;
+
+		langDef.mName = "HLSL";
+
+		inited = true;
+	}
+	return langDef;
+}
+
+const TextEditor::LanguageDefinition& TextEditor::LanguageDefinition::GLSL()
+{
+	static bool inited = false;
+	static LanguageDefinition langDef;
+	if (!inited)
+	{
+		AddWords(langDef, kCKeywords, kCIdentifiers);
+
+		langDef.mTokenize = &TokenizeShader;
+		langDef.mClassify = &Classify<kCWords>;
+
+		langDef.mCommentStart = "/*";
+		langDef.mCommentEnd = "*/";
+		langDef.mSingleLineComment = "//";
+
+		langDef.mCaseSensitive = true;
+		langDef.mAutoIndentation = true;
+
+		langDef.mName = "GLSL";
+
+		inited = true;
+	}
+	return langDef;
+}
+
+const TextEditor::LanguageDefinition& TextEditor::LanguageDefinition::C()
+{
+	static bool inited = false;
+	static LanguageDefinition langDef;
+	if (!inited)
+	{
+		AddWords(langDef, kCKeywords, kCIdentifiers);
+
+		langDef.mTokenize = &TokenizeCStyle;
+		langDef.mClassify = &Classify<kCWords>;
+
+		langDef.mCommentStart = "/*";
+		langDef.mCommentEnd = "*/";
+		langDef.mSingleLineComment = "//";
+
+		langDef.mCaseSensitive = true;
+		langDef.mAutoIndentation = true;
+
+		langDef.mName = "C";
+
+		inited = true;
+	}
+	return langDef;
+}
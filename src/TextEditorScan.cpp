@@ -0,0 +1,154 @@
+#include "Stdafx.h"
+
+#include <bit>
+
+#include "TextEditor.h"
+#include "TextEditorScan.h"
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define TEXTSCAN_SIMD
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define TEXTSCAN_SIMD
+#endif
+
+int UTF8CharLength(TextEditor::Char c);
+
+namespace
+{
+#if defined(__AVX2__)
+	constexpr int kBlockSize = 32;
+	constexpr uint32_t kFullMask = 0xffffffffu;
+
+	typedef __m256i Block;
+
+	inline Block LoadBlock(const char* p) { return _mm256_loadu_si256((const __m256i*)p); }
+	inline uint32_t MatchMask(Block aBlock, char c) { return (uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(aBlock, _mm256_set1_epi8(c))); }
+	inline uint32_t NonAsciiMask(Block aBlock) { return (uint32_t)_mm256_movemask_epi8(aBlock); }
+#elif defined(TEXTSCAN_SIMD)
+	constexpr int kBlockSize = 16;
+	constexpr uint32_t kFullMask = 0xffffu;
+
+	typedef __m128i Block;
+
+	inline Block LoadBlock(const char* p) { return _mm_loadu_si128((const __m128i*)p); }
+	inline uint32_t MatchMask(Block aBlock, char c) { return (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(aBlock, _mm_set1_epi8(c))); }
+	inline uint32_t NonAsciiMask(Block aBlock) { return (uint32_t)_mm_movemask_epi8(aBlock); }
+#endif
+
+	inline int NextColumn(int aColumn, char c, int aTabSize)
+	{
+		return c == '\t' ? (aColumn / aTabSize) * aTabSize + aTabSize : aColumn + 1;
+	}
+}
+
+const char* TextScan::FindLineBreak(const char* aBegin, const char* aEnd)
+{
+	auto p = aBegin;
+#ifdef TEXTSCAN_SIMD
+	for (; aEnd - p >= kBlockSize; p += kBlockSize)
+	{
+		auto block = LoadBlock(p);
+		auto mask = MatchMask(block, '\n') | MatchMask(block, '\r');
+		if (mask != 0)
+			return p + std::countr_zero(mask);
+	}
+#endif
+	for (; p < aEnd; ++p)
+		if (*p == '\n' || *p == '\r')
+			return p;
+	return aEnd;
+}
+
+const char* TextScan::SkipBlanks(const char* aBegin, const char* aEnd)
+{
+	auto p = aBegin;
+#ifdef TEXTSCAN_SIMD
+	for (; aEnd - p >= kBlockSize; p += kBlockSize)
+	{
+		auto block = LoadBlock(p);
+		auto mask = ~(MatchMask(block, ' ') | MatchMask(block, '\t')) & kFullMask;
+		if (mask != 0)
+			return p + std::countr_zero(mask);
+	}
+#endif
+	for (; p < aEnd; ++p)
+		if (*p != ' ' && *p != '\t')
+			return p;
+	return aEnd;
+}
+
+int TextScan::CharacterCount(const char* aBegin, const char* aEnd)
+{
+	int count = 0;
+	auto p = aBegin;
+	while (p < aEnd)
+	{
+#ifdef TEXTSCAN_SIMD
+		if (aEnd - p >= kBlockSize)
+		{
+			// every ASCII byte before the first lead byte is one character
+			auto mask = NonAsciiMask(LoadBlock(p));
+			auto ascii = mask != 0 ? std::countr_zero(mask) : kBlockSize;
+			count += ascii;
+			p += ascii;
+			if (ascii == kBlockSize)
+				continue;
+		}
+#endif
+		p += UTF8CharLength(*p);
+		++count;
+	}
+	return count;
+}
+
+int TextScan::ColumnAt(const char* aBegin, const char* aEnd, int aTabSize)
+{
+	int column = 0;
+	auto p = aBegin;
+	while (p < aEnd)
+	{
+#ifdef TEXTSCAN_SIMD
+		if (aEnd - p >= kBlockSize)
+		{
+			auto block = LoadBlock(p);
+			auto mask = NonAsciiMask(block) | MatchMask(block, '\t');
+			auto plain = mask != 0 ? std::countr_zero(mask) : kBlockSize;
+			column += plain;
+			p += plain;
+			if (plain == kBlockSize)
+				continue;
+		}
+#endif
+		auto c = *p;
+		p += UTF8CharLength(c);
+		column = NextColumn(column, c, aTabSize);
+	}
+	return column;
+}
+
+int TextScan::IndexOfColumn(const char* aBegin, const char* aEnd, int aColumn, int aTabSize)
+{
+	int column = 0;
+	auto p = aBegin;
+	while (p < aEnd && column < aColumn)
+	{
+#ifdef TEXTSCAN_SIMD
+		if (aEnd - p >= kBlockSize)
+		{
+			auto block = LoadBlock(p);
+			auto mask = NonAsciiMask(block) | MatchMask(block, '\t');
+			auto plain = std::min(mask != 0 ? std::countr_zero(mask) : kBlockSize, aColumn - column);
+			column += plain;
+			p += plain;
+			if (plain == kBlockSize || column >= aColumn)
+				continue;
+		}
+#endif
+		auto c = *p;
+		p += UTF8CharLength(c);
+		column = NextColumn(column, c, aTabSize);
+	}
+	return (int)(p - aBegin);
+}
@@ -0,0 +1,24 @@
+#pragma once
+
+// Byte scanning kernels used by the text editor on whole lines and documents. They process
+// 32 bytes at a time with AVX2 or 16 with SSE2, depending on the target the build enables,
+// and fall back to a plain loop elsewhere. Blocks that are pure ASCII without tabs are
+// consumed in one step, other bytes go through UTF8CharLength exactly like the scalar code.
+namespace TextScan
+{
+	// First '\n' or '\r' in [aBegin, aEnd), aEnd if there is none
+	const char* FindLineBreak(const char* aBegin, const char* aEnd);
+
+	// First character in [aBegin, aEnd) that is not a space or a tab
+	const char* SkipBlanks(const char* aBegin, const char* aEnd);
+
+	// Number of UTF-8 characters starting in [aBegin, aEnd)
+	int CharacterCount(const char* aBegin, const char* aEnd);
+
+	// Column reached after the characters starting in [aBegin, aEnd), tabs expanded to aTabSize
+	int ColumnAt(const char* aBegin, const char* aEnd, int aTabSize);
+
+	// Byte offset of the first character at or past aColumn, at most the end of the text
+	// rounded up to a character boundary
+	int IndexOfColumn(const char* aBegin, const char* aEnd, int aColumn, int aTabSize);
+}
@@ -1,10 +1,15 @@
 #include "Stdafx.h"
 #include "PaperCode.h"
 #include "TextEditor.h"
+#include "MappedFile.h"
+
+// Files from this size on are shown read-only straight from the mapping instead of being loaded
+static constexpr size_t kLargeFileSize = 16 * 1024 * 1024;
 
 void UIEditor::init() {
     mImEditor = std::make_shared<TextEditor>();
     mImEditor->SetShowWhitespaces(false);
+    mImEditor->SetRedrawCallback([] () { UISystem::get().wakeUp(); });
 }
 
 void UIEditor::destroy() {
@@ -23,6 +28,25 @@ int UIEditor::getTabSize() const {
     return mImEditor->GetTabSize(); 
 }
 
+float UIEditor::getRedrawDelay() const {
+    return mImEditor->GetRedrawDelay();
+}
+
+std::shared_ptr<const std::string> UIEditor::getSnapshot(uint64_t* version) {
+    // Versions come from one counter so they keep growing when a file is closed and reopened
+    static uint64_t sSnapshotVersion = 0;
+
+    if (!mSnapshot || mSnapshotTextVersion != mImEditor->GetTextVersion()) {
+        mSnapshot = std::make_shared<const std::string>(mImEditor->GetText());
+        mSnapshotTextVersion = mImEditor->GetTextVersion();
+        mSnapshotVersion = ++sSnapshotVersion;
+    }
+    if (version) {
+        *version = mSnapshotVersion;
+    }
+    return mSnapshot;
+}
+
 bool UIEditor::isFileOpen(const std::filesystem::path& filepath) const { 
     return mFilePath.compare(filepath) == 0; 
 }
@@ -57,11 +81,16 @@ void UIEditor::openFile(const std::filesystem::path& filePath) {
         mImEditor->SetLanguageDefinition(lang);
     }
 
-    std::ifstream t(filePath);
-    if (t.good()) {
-        std::string str((std::istreambuf_iterator<char>(t)), std::istreambuf_iterator<char>());
-        mImEditor->SetText(str);
-        t.close();
+    auto file = std::make_shared<MappedFile>();
+    if (file->open(filePath)) {
+        std::string_view text(file->data(), file->size());
+        mLargeFile = file->size() >= kLargeFileSize;
+        if (mLargeFile) {
+            std::cout << "LOG: File '" << filePath << "' is large, opening it read-only" << std::endl;
+            mImEditor->SetTextView(text, file);
+        } else {
+            mImEditor->SetText(text);
+        }
 
         mFirstLoaded = true;
     } else {
@@ -72,6 +101,9 @@ void UIEditor::openFile(const std::filesystem::path& filePath) {
 void UIEditor::saveToFile() {
     if (mFilePath.empty())
         return;
+    // Large files are read-only, and the mapping must not be written to while it is shown
+    if (mLargeFile)
+        return;
     // Lets see if the file doesn't exist yet
     if (!std::filesystem::exists(mFilePath)) {
         std::cout << "LOG: File '" << mFilePath << "' doesn't exist. Creating one..." << std::endl;
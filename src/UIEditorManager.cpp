@@ -3,7 +3,7 @@
 #include "TextEditor.h"
 #include "ImGuiHelper.h"
 
-void notifySmartSense(const std::string& filepath, const std::string& buf);
+void notifySmartSense(const std::string& filepath, uint64_t version, std::shared_ptr<const std::string> text);
 
 void UIEditorManager::saveActive() {
 	if (mActiveEditor) {
@@ -202,9 +202,17 @@ void UIEditorManager::draw() {
 
                 // Lets notify the smart sense that codes has been modified
                 // Since the code might not be saved to a file yet. We will also
-                // provide the editor's full text buffer to parse
+                // provide a snapshot of the editor's text buffer to parse
+                auto now = std::chrono::steady_clock::now();
                 if (textModified) {
-                    notifySmartSense(e->getFilePath().string(), e->mImEditor->GetText());
+                    e->mSnapshotPending = true;
+                    e->mLastEdit = now;
+                }
+                if (e->mSnapshotPending && now - e->mLastEdit >= kSnapshotDelay) {
+                    uint64_t version;
+                    auto text = e->getSnapshot(&version);
+                    notifySmartSense(e->getFilePath().string(), version, std::move(text));
+                    e->mSnapshotPending = false;
                 }
                 n++;
             }
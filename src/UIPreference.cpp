@@ -2,13 +2,20 @@
 #include "PaperCode.h"
 #include "ImGuiHelper.h"
 
+void updateSmartSenseSettings();
+
 void UIPreference::open() {
-    
+    mSmartSenseThreads = PaperCode::get().mSettings.mSmartSenseThreads;
+    mReparseDelay = PaperCode::get().mSettings.mReparseDelay;
+
     ImGui::OpenPopup("Preference");
 }
 
 void UIPreference::applyChanges() {
-    
+    // The thread count is picked up when the next project is opened, the delay right away
+    PaperCode::get().mSettings.mSmartSenseThreads = mSmartSenseThreads;
+    PaperCode::get().mSettings.mReparseDelay = mReparseDelay;
+    updateSmartSenseSettings();
 }
 
 void UIPreference::close() {
@@ -20,7 +27,32 @@ void UIPreference::draw() {
     if (ImGui::BeginTabBar("PreferenceTabs", tab_bar_flags)) {
 
         if (ImGui::BeginTabItem("General")) {
-            
+
+            ImGui::Columns(2);
+            ImGui::SetColumnWidth(0, 170.0f);
+            ImGui::AlignTextToFramePadding();
+            ImGui::Text("%s", "SmartSense Threads:");
+            ImGui::NextColumn();
+            ImGui::PushItemWidth(120.0f);
+            if (ImGui::InputInt("##SmartSenseThreads", &mSmartSenseThreads)) {
+                mSmartSenseThreads = std::max(mSmartSenseThreads, 0);
+            }
+            ImGui::PopItemWidth();
+            ImGui::SameLine();
+            ImGui::TextDisabled("%s", "0 = automatic, at most 4");
+            ImGui::NextColumn();
+
+            ImGui::AlignTextToFramePadding();
+            ImGui::Text("%s", "Reparse Delay:");
+            ImGui::NextColumn();
+            ImGui::PushItemWidth(120.0f);
+            if (ImGui::InputInt("##ReparseDelay", &mReparseDelay, 100, 500)) {
+                mReparseDelay = std::max(mReparseDelay, 0);
+            }
+            ImGui::PopItemWidth();
+            ImGui::SameLine();
+            ImGui::TextDisabled("%s", "ms after the last keystroke");
+            ImGui::Columns(1);
 
             ImGui::EndTabItem();
         }
@@ -139,6 +139,20 @@ void UIProjectProperties::draw() {
                 ImGui_Select<BuildLanguageStandard>(mProperties.mBuildOption.mLanguageStandard, BuildLanguageStandardString, "Language Standard");
                 ImGui_DrawProperties("Additional Flags:", &mProperties.mBuildOption.mAdditionalCompileFlags);
 
+                ImGui::Columns(2);
+                ImGui::SetColumnWidth(0, 170.0f);
+                ImGui::AlignTextToFramePadding();
+                ImGui::Text("%s", "Parallel Jobs:");
+                ImGui::NextColumn();
+                ImGui::PushItemWidth(120.0f);
+                if (ImGui::InputInt("##Jobs", &mProperties.mBuildOption.mJobs)) {
+                    mProperties.mBuildOption.mJobs = std::max(mProperties.mBuildOption.mJobs, 0);
+                }
+                ImGui::PopItemWidth();
+                ImGui::SameLine();
+                ImGui::TextDisabled("%s", "0 = one per CPU thread");
+                ImGui::Columns(1);
+
                 ImGui::EndTabItem();
             }
 
@@ -0,0 +1,169 @@
+#include "Stdafx.h"
+#include "PaperCode.h"
+#include "TextEditor.h"
+#include "TextEditorCompletion.h"
+
+// Symbols listed at most, the pattern has to narrow it down from there
+static constexpr size_t kMaxResults = 200;
+// How often the index is rebuilt while SmartSense is still finding symbols
+static constexpr std::chrono::milliseconds kRebuildInterval{ 500 };
+
+void UIQuickOpen::open() {
+    mPattern[0] = '\0';
+    mSearchedPattern.clear();
+    mSelected = 0;
+    mFocusPattern = true;
+    update(true);
+
+    ImGui::OpenPopup("Go to Symbol");
+}
+
+void UIQuickOpen::close() {
+    ImGui::CloseCurrentPopup();
+}
+
+void UIQuickOpen::update(bool search) {
+    auto smartSense = PaperCode::get().getSmartSense();
+    if (!smartSense) {
+        mSearch = nullptr;
+        mResults.clear();
+        return;
+    }
+
+    // A finished build replaces the index, unless it was for the SmartSense of another project
+    bool rebuilt = false;
+    if (mBuilding) {
+        std::shared_ptr<SymbolSearch> built;
+        {
+            std::lock_guard<std::mutex> lock(mBuildMutex);
+            built = std::move(mBuilt);
+        }
+        if (built) {
+            mBuilding = false;
+            if (mBuildSource == smartSense.get()) {
+                mSearch = std::move(built);
+                mSymbolsSource = mBuildSource;
+                mSymbolsVersion = mBuildVersion;
+                rebuilt = true;
+            }
+        }
+    }
+    if (mSearch && mSymbolsSource != smartSense.get()) {
+        mSearch = nullptr;
+        mResults.clear();
+    }
+
+    // The index is only rebuilt when SmartSense found new symbols, searching it again is cheap.
+    // Building takes tens of milliseconds on a large project, so it runs on mBuildThread while the
+    // popup keeps searching the previous index. A scan finds new symbols with every file, so
+    // during one a build starts at most every kRebuildInterval and once more when the scan is done.
+    uint64_t version = smartSense->getSymbolsVersion();
+    auto now = std::chrono::steady_clock::now();
+    bool build = !mSearch;
+    if (!build && version != mSymbolsVersion) {
+        build = smartSense->getState() == SmartSenseState::Idle || now - mSymbolsBuilt >= kRebuildInterval;
+    }
+    if (build && !mBuilding) {
+        mBuilding = true;
+        mBuildSource = smartSense.get();
+        mBuildVersion = version;
+        mSymbolsBuilt = now;
+        mBuildThread = std::jthread([this, smartSense] () {
+            auto search = std::make_shared<SymbolSearch>();
+            search->Build(smartSense->getDatabase());
+            {
+                std::lock_guard<std::mutex> lock(mBuildMutex);
+                mBuilt = std::move(search);
+            }
+            UISystem::get().wakeUp();
+        });
+    }
+
+    if (!mSearch) {
+        return;
+    }
+
+    // A pattern starting with '^' lists the names starting with the rest of it, in name order
+    if (search || rebuilt || mSearchedPattern != mPattern) {
+        mSearchedPattern = mPattern;
+        if (mSearchedPattern.starts_with('^')) {
+            mSearch->FindPrefix(std::string_view(mSearchedPattern).substr(1), kMaxResults, mResults);
+        } else {
+            mSearch->Search(mSearchedPattern, kMaxResults, mResults);
+        }
+        mSelected = std::clamp(mSelected, 0, std::max((int)mResults.size() - 1, 0));
+    }
+}
+
+void UIQuickOpen::jumpTo(uint32_t symbol) {
+    const SymbolSearch::Symbol& sym = mSearch->GetSymbol(symbol);
+
+    UIEditorPtr editor = UISystem::get().getEditorManager().openEditor(mSearch->GetFile(sym));
+    editor->mFlagSelected = true;
+    editor->mImEditor->SetCursorPosition(TextEditor::Coordinates(std::max(sym.mLine - 1, 0), 0));
+
+    close();
+}
+
+void UIQuickOpen::draw() {
+    if (mFocusPattern) {
+        ImGui::SetKeyboardFocusHere();
+        mFocusPattern = false;
+    }
+
+    ImGui::PushItemWidth(-1);
+    if (ImGui::InputText("##Pattern", mPattern, sizeof(mPattern))) {
+        mSelected = 0;
+    }
+    ImGui::PopItemWidth();
+
+    update();
+
+    bool moved = false;
+    if (ImGui::IsKeyPressed(ImGui::GetKeyIndex(ImGuiKey_DownArrow)) && mSelected + 1 < (int)mResults.size()) {
+        mSelected++;
+        moved = true;
+    }
+    if (ImGui::IsKeyPressed(ImGui::GetKeyIndex(ImGuiKey_UpArrow)) && mSelected > 0) {
+        mSelected--;
+        moved = true;
+    }
+    if (ImGui::IsKeyPressed(ImGui::GetKeyIndex(ImGuiKey_Escape))) {
+        close();
+        return;
+    }
+    if (ImGui::IsKeyPressed(ImGui::GetKeyIndex(ImGuiKey_Enter)) && mSelected < (int)mResults.size()) {
+        jumpTo(mResults[mSelected]);
+        return;
+    }
+
+    ImGui::BeginChild("##Symbols");
+
+    if (!mSearch || mSearch->GetSymbolCount() == 0) {
+        ImGui::TextDisabled("%s", "No symbols yet, SmartSense is still scanning the project...");
+    } else if (mResults.empty()) {
+        ImGui::TextDisabled("%s", "No match. Start with ^ to list the names starting with the rest.");
+    }
+
+    int clicked = -1;
+    for (int i = 0; i < (int)mResults.size(); i++) {
+        const SymbolSearch::Symbol& sym = mSearch->GetSymbol(mResults[i]);
+        std::string label = std::format("{}##{}", mSearch->GetName(sym), i);
+
+        if (ImGui::Selectable(label.c_str(), i == mSelected)) {
+            clicked = i;
+        }
+        if (i == mSelected && moved) {
+            ImGui::SetScrollHereY();
+        }
+
+        ImGui::SameLine();
+        ImGui::TextDisabled("%s:%d", std::filesystem::path(mSearch->GetFile(sym)).filename().string().c_str(), sym.mLine);
+    }
+
+    ImGui::EndChild();
+
+    if (clicked >= 0) {
+        jumpTo(mResults[clicked]);
+    }
+}
@@ -14,6 +14,11 @@ void drawSmartSenseState();
 std::string OpenFileDialog(GLFWwindow* window, std::vector<std::string> const &filters);
 bool glfwSetWindowCenter( GLFWwindow * window );
 
+// ImGui settles hover, focus and popups a frame or two after the input that caused them
+static constexpr int kActiveFrames = 3;
+// Longest idle wait, so hover tooltips still show up without further input
+static constexpr double kIdleTimeout = 0.5;
+
 void GLFW_error(int error, const char* description) {
     std::cout << "GLFW ERROR(" << error << "):" << description << std::endl;
 }
@@ -169,15 +174,51 @@ bool UISystem::runEventLoop() {
 
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
         drawEvent();
-	    glfwPollEvents();
 
         handleKeyboardInputs();
 
         glfwSwapBuffers(mWindow);
+
+        waitEvents();
 	}
     return true;
 }
 
+void UISystem::waitEvents() {
+    // Draw back to back while input is being handled. Otherwise sleep until the next event,
+    // a wakeUp() from a worker thread or the active editor's next deadline (cursor blink).
+    if (mActiveFrames > 0) {
+        mActiveFrames--;
+        glfwPollEvents();
+        return;
+    }
+
+    double timeout = kIdleTimeout;
+    UIEditorPtr editor = mEditorManager.getActiveEditor();
+    if (editor) {
+        float delay = editor->getRedrawDelay();
+        if (delay >= 0.0f) {
+            timeout = std::min(timeout, (double)delay);
+        }
+    }
+
+    if (timeout <= 0.0) {
+        glfwPollEvents();
+        return;
+    }
+
+    double start = glfwGetTime();
+    glfwWaitEventsTimeout(timeout);
+    if (glfwGetTime() - start < timeout) {
+        // Woken up by an event rather than by the deadline
+        mActiveFrames = kActiveFrames;
+    }
+}
+
+void UISystem::wakeUp() {
+    glfwPostEmptyEvent();
+}
+
 void UISystem::handleKeyboardInputs() {
     ImGuiIO& io = ImGui::GetIO();
     auto shift = io.KeyShift;
@@ -189,14 +230,22 @@ void UISystem::handleKeyboardInputs() {
     if (ctrl && !shift && !alt && ImGui::IsKeyPressed(ImGui::GetKeyIndex(ImGuiKey_S))) {
         PaperCode::get().executeCommand(Commands::SaveCurrent);
     }
+
+    if (ctrl && !shift && !alt && ImGui::IsKeyPressed(ImGui::GetKeyIndex(ImGuiKey_T))) {
+        if (PaperCode::get().getActiveProject()) {
+            mQuickOpen.mTriggerPopup = true;
+        }
+    }
 }
 
 void UISystem::clearBuildLogs() {
     mBuildLogs.clear();
+    wakeUp();
 }
 
 void UISystem::appendBuildLog(const std::string& log, LogType type) {
     mBuildLogs.log(log, type);
+    wakeUp();
 }
 
 void UISystem::drawToolbar() {
@@ -244,6 +293,10 @@ void UISystem::drawToolbar() {
             PaperCode::get().executeCommand(Commands::Build);
         }
         ImGui_QuickTooltip("Build Active Project", mDefaultFontGUI);
+        if (ImGui::Button(ICON_FA_REDO, toolBtnSize)) {
+            PaperCode::get().executeCommand(Commands::Rebuild);
+        }
+        ImGui_QuickTooltip("Rebuild All (ignore up-to-date files)", mDefaultFontGUI);
         //ImGui::SameLine();
         if (PaperCode::get().isProjectRunning()) {
             if (ImGui::Button(ICON_FA_STOP, toolBtnSize)) {
@@ -309,6 +362,17 @@ void UISystem::drawUI() {
         ImGui::EndPopup();
     }
 
+    if (mQuickOpen.mTriggerPopup) {
+        mQuickOpen.mTriggerPopup = false;
+        mQuickOpen.open();
+    }
+
+    ImGui::SetNextWindowSize(ImVec2(600, 400), ImGuiCond_Appearing);
+    if (ImGui::BeginPopupModal("Go to Symbol")) {
+        mQuickOpen.draw();
+        ImGui::EndPopup();
+    }
+
     if (ImGui::BeginPopupModal((mMsgBox.mTitle + "###Message Box").c_str(), 0, 0/*ImGuiWindowFlags_NoResize*/)) {
         mMsgBox.draw();
         ImGui::EndPopup();
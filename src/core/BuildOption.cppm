@@ -8,6 +8,7 @@ module;
 #include <vector>
 #include <memory> 
 #include <filesystem>
+#include <algorithm>
 #include <yaml-cpp/yaml.h>
 
 export module buildoption;
@@ -87,6 +88,9 @@ export struct BuildOption {
     std::string mAdditionalCompileFlags = "";
     std::string mAdditionalLinkFlags = "";
 
+    // Compiler processes run at once, 0 runs one per hardware thread
+    int mJobs = 0;
+
     //
     std::map<std::string, BuildLanguageStandard> langMap;
     std::map<std::string, BuildType> typeMap;
@@ -137,6 +141,7 @@ export struct BuildOption {
         out << YAML::Key << "Sub System" << YAML::Value << getSubSystemAsString();
     	out << YAML::Key << "Compile Flags" << YAML::Value << mAdditionalCompileFlags;
     	out << YAML::Key << "Link Flags" << YAML::Value << mAdditionalLinkFlags;
+        out << YAML::Key << "Jobs" << YAML::Value << mJobs;
     }
 
     void deserialize(const YAML::Node& data) {
@@ -158,6 +163,9 @@ export struct BuildOption {
 	    if (data["Link Flags"]) {
 	        mAdditionalLinkFlags = data["Link Flags"].as<std::string>();
 	    }
+        if (data["Jobs"]) {
+            mJobs = std::max(data["Jobs"].as<int>(), 0);
+        }
     }
 };
 
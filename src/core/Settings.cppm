@@ -1,6 +1,7 @@
 module;
 
 #include <assert.h>
+#include <algorithm>
 #include <iostream>
 #include <fstream>
 #include <string>
@@ -24,6 +25,11 @@ export struct ApplicationSettings {
     float mEditorFontSize = 15.0f;
     std::string mThemeName = "Default";
 
+    // Files SmartSense parses at once during a full scan, 0 lets SmartSense pick
+    int mSmartSenseThreads = 0;
+    // Milliseconds from the last keystroke until SmartSense reparses the edited file
+    int mReparseDelay = 1000;
+
     void addToRecentProject(const std::string& filepath);
     void removeFromRecentProject(const std::string& filepath);
     void removeRecent(const Recent& recent);
@@ -74,6 +80,8 @@ void ApplicationSettings::serialize() {
     out << YAML::BeginMap;
 
     out << YAML::Key << "Editor Font Size" << YAML::Value << mEditorFontSize;
+    out << YAML::Key << "SmartSense Threads" << YAML::Value << mSmartSenseThreads;
+    out << YAML::Key << "SmartSense Reparse Delay" << YAML::Value << mReparseDelay;
 
     out << YAML::Key << "Recent Projects" << YAML::Value << YAML::BeginSeq;
 
@@ -110,6 +118,12 @@ bool ApplicationSettings::deserialize() {
     }
 
     mEditorFontSize = data["Editor Font Size"].as<float>();
+    if (data["SmartSense Threads"]) {
+        mSmartSenseThreads = std::max(data["SmartSense Threads"].as<int>(), 0);
+    }
+    if (data["SmartSense Reparse Delay"]) {
+        mReparseDelay = std::max(data["SmartSense Reparse Delay"].as<int>(), 0);
+    }
 
     auto files = data["Recent Projects"];
     if (files) {
@@ -3,9 +3,17 @@ module;
 /* This Module is heavily dependent on Windows Platform and Windows API functions
  */
 #include <string>
+#include <string_view>
 #include <vector>
+#include <memory>
 #include <iostream>
 #include <functional>
+#include <chrono>
+#include <mutex>
+#include <thread>
+#include <algorithm>
+#include <cerrno>
+#include <climits>
  
 #if defined(WIN32)
 
@@ -16,6 +24,13 @@ module;
 #elif defined (__unix__) || (defined (__APPLE__) && defined (__MACH__))
 
 #include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/wait.h>
+
+#if defined(__linux__)
+#include <sys/syscall.h>
+#endif
 
 #else
     #error port to this platform
@@ -39,6 +54,12 @@ export SubProcessFlags operator&(SubProcessFlags lhs, SubProcessFlags rhs)  {
     return static_cast<SubProcessFlags>(static_cast<char>(lhs) & static_cast<char>(rhs));
 }
 
+// With RedirectOutput stdout and stderr are captured on pipes of their own
+export enum class SubProcessStream {
+    Output,
+    Error
+};
+
 export class ISubProcess
 {
 public:
@@ -46,11 +67,21 @@ public:
 
     virtual void cleanUp() = 0;
     virtual bool create(const std::string& cmd, SubProcessFlags flags) = 0;
+    // Blocks until both streams are closed, handing over whatever arrives on either of them
     virtual void read(std::function<void(const std::string&)> cb) = 0;
+    // Reads what is available without blocking. Returns the byte count, 0 once the stream
+    // is closed and -1 when nothing is there yet.
+    virtual int readSome(SubProcessStream stream, char* buffer, int size) = 0;
     virtual void terminate() = 0;
     virtual bool isAlive() = 0;
     virtual bool getExitCode(int *pExitCode) = 0;
+
+    // Blocks until the process exits and returns its exit code, -1 if it can't be told
     virtual int wait() = 0;
+    // Blocks for at most timeout, a negative one waits forever. Returns true once the process exited.
+    virtual bool waitFor(std::chrono::milliseconds timeout) = 0;
+    // Wall-clock time from start to exit, or up to now while still running
+    virtual std::chrono::steady_clock::duration getElapsedTime() = 0;
 };
 
 #if defined(WIN32)
@@ -62,6 +93,8 @@ public:
 
     HANDLE g_hChildStd_OUT_Rd = NULL;
     HANDLE g_hChildStd_OUT_Wr = NULL;
+    HANDLE g_hChildStd_ERR_Rd = NULL;
+    HANDLE g_hChildStd_ERR_Wr = NULL;
 
     SubProcessWin32() {
         ZeroMemory( &pi, sizeof(pi) );
@@ -73,6 +106,13 @@ public:
             terminate();
         }
         cleanUp();
+
+        if (g_hChildStd_OUT_Rd != NULL) {
+            CloseHandle(g_hChildStd_OUT_Rd);
+        }
+        if (g_hChildStd_ERR_Rd != NULL) {
+            CloseHandle(g_hChildStd_ERR_Rd);
+        }
     }
 
     void cleanUp() {
@@ -112,6 +152,15 @@ public:
                 printf("CRITICAL ERROR: STDOUT is inherited\n");
                 return false;
             }
+            // Same for STDERR
+            if ( ! CreatePipe(&g_hChildStd_ERR_Rd, &g_hChildStd_ERR_Wr, &saAttr, 0) ) {
+                printf("CRITICAL ERROR: Failed to create pipe for STDERR\n");
+                return false;
+            }
+            if ( ! SetHandleInformation(g_hChildStd_ERR_Rd, HANDLE_FLAG_INHERIT, 0) ){
+                printf("CRITICAL ERROR: STDERR is inherited\n");
+                return false;
+            }
         }
 
         siStartInfo.cb = sizeof(siStartInfo);
@@ -124,7 +173,7 @@ public:
             siStartInfo.dwFlags |= STARTF_USESTDHANDLES;
             siStartInfo.hStdInput = GetStdHandle(STD_INPUT_HANDLE);
             siStartInfo.hStdOutput = g_hChildStd_OUT_Wr;
-            siStartInfo.hStdError = g_hChildStd_OUT_Wr;
+            siStartInfo.hStdError = g_hChildStd_ERR_Wr;
         }
 
         DWORD creationFlags = flags & SubProcessFlags::CreateConsole ? CREATE_NEW_CONSOLE : CREATE_NO_WINDOW;
@@ -148,23 +197,57 @@ public:
 
         if (redirectOutput) {
             CloseHandle(g_hChildStd_OUT_Wr);
+            CloseHandle(g_hChildStd_ERR_Wr);
         }
         return true;
     }
 
     void read(std::function<void(const std::string&)> cb) {
-        DWORD dwRead; 
         CHAR chBuf[BUFSIZE]; 
-        BOOL bSuccess = FALSE;
+        bool open[2] = { true, true };
+
+        // Reading one pipe to its end first could stall a child blocked on a full other pipe,
+        // so take turns and nap while both are empty
+        while (open[0] || open[1]) {
+            bool received = false;
+            for (int i = 0; i < 2; i++) {
+                if (!open[i]) {
+                    continue;
+                }
+                int bytesRead = readSome((SubProcessStream) i, chBuf, BUFSIZE);
+                if (bytesRead > 0) {
+                    cb(std::string(chBuf, bytesRead));
+                    received = true;
+                } else if (bytesRead == 0) {
+                    open[i] = false;
+                }
+            }
+            if (!received) {
+                Sleep(1);
+            }
+        }
+    }
 
-        for (;;)  {
-            bSuccess = ReadFile(g_hChildStd_OUT_Rd, chBuf, BUFSIZE, &dwRead, NULL);
-            if( ! bSuccess || dwRead == 0 ) 
-                break; 
+    int readSome(SubProcessStream stream, char* buffer, int size) {
+        HANDLE pipe = stream == SubProcessStream::Output ? g_hChildStd_OUT_Rd : g_hChildStd_ERR_Rd;
+        if (pipe == NULL) {
+            return 0;
+        }
 
-            std::string ss(chBuf, dwRead);
-            cb(ss);
-        } 
+        // Anonymous pipes have no non-blocking mode, peek first. Fails with a broken pipe once the child is gone.
+        DWORD available = 0;
+        if (!PeekNamedPipe(pipe, nullptr, 0, nullptr, &available, nullptr)) {
+            return 0;
+        }
+        if (available == 0) {
+            return -1;
+        }
+
+        DWORD bytesRead = 0;
+        if (!ReadFile(pipe, buffer, std::min<DWORD>(available, (DWORD) size), &bytesRead, nullptr)) {
+            return 0;
+        }
+        return (int) bytesRead;
     }
 
     void terminate() {
@@ -194,7 +277,38 @@ public:
     }
 
     int wait() {
-        return (int) WaitForSingleObject(pi.hProcess, INFINITE); 
+        int exitCode;
+        if (!waitFor(std::chrono::milliseconds(-1)) || !getExitCode(&exitCode)) {
+            return -1;
+        }
+        return exitCode;
+    }
+
+    bool waitFor(std::chrono::milliseconds timeout) {
+        if (pi.hProcess == nullptr) {
+            return true;
+        }
+        DWORD milliseconds = timeout.count() < 0 ? INFINITE : (DWORD) std::min<long long>(timeout.count(), INFINITE - 1);
+        return WaitForSingleObject(pi.hProcess, milliseconds) == WAIT_OBJECT_0;
+    }
+
+    std::chrono::steady_clock::duration getElapsedTime() {
+        FILETIME creationTime, exitTime, kernelTime, userTime;
+        if (pi.hProcess == nullptr || !GetProcessTimes(pi.hProcess, &creationTime, &exitTime, &kernelTime, &userTime)) {
+            return {};
+        }
+        if (isAlive()) {
+            GetSystemTimeAsFileTime(&exitTime);
+        }
+
+        // FILETIMEs count 100 ns intervals
+        ULARGE_INTEGER start, end;
+        start.LowPart = creationTime.dwLowDateTime;
+        start.HighPart = creationTime.dwHighDateTime;
+        end.LowPart = exitTime.dwLowDateTime;
+        end.HighPart = exitTime.dwHighDateTime;
+        auto ticks = std::chrono::duration<long long, std::ratio<1, 10000000>>(end.QuadPart - start.QuadPart);
+        return std::chrono::duration_cast<std::chrono::steady_clock::duration>(ticks);
     }
 };
 
@@ -216,13 +330,33 @@ public:
         , running(false)
         , exitCode(-1) {
         // Initialize pipes
-        if (pipe(outputPipe) == -1) {
+        if (openPipe(outputPipe) == -1) {
             std::cerr << "Failed to create output pipe" << std::endl;
         }
+        if (openPipe(errorPipe) == -1) {
+            std::cerr << "Failed to create error pipe" << std::endl;
+        }
+        // Only the parent reads, and it never wants to block on a single stream
+        for (int* pipe : { outputPipe, errorPipe }) {
+            if (pipe[0] != -1) {
+                fcntl(pipe[0], F_SETFL, fcntl(pipe[0], F_GETFL) | O_NONBLOCK);
+            }
+        }
     }
 
     ~SubProcessPosix() {
-        terminate();
+        // Kill and reap whatever is still running, so no zombie is left behind
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (running) {
+                kill(pid, SIGKILL);
+            }
+        }
+        reap(0);
+        closePipe(outputPipe[0]);
+        closePipe(outputPipe[1]);
+        closePipe(errorPipe[0]);
+        closePipe(errorPipe[1]);
     }
 
     void cleanUp() override {
@@ -234,23 +368,42 @@ public:
         tokenize(cmd, args);
         args.push_back(nullptr);
 
+        // Formatted up front, after the fork the child may only use async-signal-safe calls
+        std::string execError = "Failed to execute command: " + cmd + "\n";
+
         pid = fork();
+        if (pid != 0) {
+            // The child has a copy of its own
+            for (char* arg : args) {
+                free(arg);
+            }
+        }
+
         if (pid == 0) {
             // Child process
             if (flags & SubProcessFlags::RedirectOutput) {
-                // Redirect stdout to the write end of the pipe
+                // Redirect stdout and stderr to the write ends of the pipes
                 dup2(outputPipe[1], STDOUT_FILENO);
+                dup2(errorPipe[1], STDERR_FILENO);
             }
-            close(outputPipe[0]); // Close the read end of the pipe
+            close(outputPipe[0]); // Close the read ends of the pipes
+            close(errorPipe[0]);
 
             if (execvp(args[0], args.data()) == -1) {
-                std::cerr << "Failed to execute command: " << cmd << std::endl;
-                exit(EXIT_FAILURE);
+                [[maybe_unused]] ssize_t written = write(STDERR_FILENO, execError.data(), execError.size());
+                // _exit, the copies of other threads' locks must not be touched by exit handlers
+                _exit(EXIT_FAILURE);
             }
         } else if (pid > 0) {
             // Parent process
+            startTime = std::chrono::steady_clock::now();
             running = true;
-            close(outputPipe[1]); // Close the write end of the pipe
+            closePipe(outputPipe[1]); // Close the write ends of the pipes
+            closePipe(errorPipe[1]);
+#if defined(SYS_pidfd_open)
+            // Becomes readable when the process exits, lets waitFor sleep in poll. Fails on kernels before 5.3.
+            pidFd = (int) syscall(SYS_pidfd_open, pid, 0);
+#endif
         } else {
             // Fork failed
             std::cerr << "Fork failed" << std::endl;
@@ -260,41 +413,68 @@ public:
     }
 
     void read(std::function<void(const std::string &)> cb) override {
-        if (!running) {
+        if (pid <= 0) {
             std::cerr << "Process is not running" << std::endl;
             return;
         }
 
         char buffer[BUFSIZ];
+        pollfd fds[2] = { { outputPipe[0], POLLIN, 0 }, { errorPipe[0], POLLIN, 0 } };
+
+        // poll skips the negative descriptors of closed streams
+        while (fds[0].fd != -1 || fds[1].fd != -1) {
+            if (::poll(fds, 2, -1) == -1) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                std::cerr << "Failed to poll pipes" << std::endl;
+                return;
+            }
+            for (int i = 0; i < 2; i++) {
+                if (fds[i].fd == -1 || fds[i].revents == 0) {
+                    continue;
+                }
+                int bytesRead;
+                while ((bytesRead = readSome((SubProcessStream) i, buffer, BUFSIZ)) > 0) {
+                    cb(std::string(buffer, bytesRead));
+                }
+                if (bytesRead == 0) {
+                    fds[i].fd = -1;
+                }
+            }
+        }
+    }
+
+    int readSome(SubProcessStream stream, char* buffer, int size) override {
+        int fd = getPipe(stream);
+        if (fd == -1) {
+            return 0;
+        }
+
         ssize_t bytesRead;
-        while ((bytesRead = ::read(outputPipe[0], buffer, BUFSIZ)) > 0) {
-            std::string data(buffer, bytesRead);
-            cb(data);
+        while ((bytesRead = ::read(fd, buffer, size)) == -1 && errno == EINTR) {
         }
-        if (bytesRead == -1) {
-            std::cerr << "Failed to read from pipe" << std::endl;
+        if (bytesRead >= 0) {
+            return (int) bytesRead;
         }
+        return errno == EAGAIN || errno == EWOULDBLOCK ? -1 : 0;
+    }
+
+    // Read end of the stream's pipe, for poll()
+    int getPipe(SubProcessStream stream) const {
+        return stream == SubProcessStream::Output ? outputPipe[0] : errorPipe[0];
     }
 
     void terminate() override {
+        // The process stays running until reaped, wait() reports how it ended
+        std::lock_guard<std::mutex> lock(mutex);
         if (running) {
             kill(pid, SIGTERM);
-            running = false;
         }
     }
 
     bool isAlive() override {
-        if (!running) {
-            return false;
-        }
-
-        int status;
-        if (waitpid(pid, &status, WNOHANG) == 0) {
-            return true;
-        } else {
-            running = false;
-            return false;
-        }
+        return !reap(WNOHANG);
     }
 
     bool getExitCode(int *pExitCode) override {
@@ -309,23 +489,110 @@ public:
     }
 
     int wait() override {
-        if (running) {
-            int status;
-            if (waitpid(pid, &status, 0) > 0) {
-                if (WIFEXITED(status)) {
-                    exitCode = WEXITSTATUS(status);
-                    return exitCode;
-                }
+        // Sleep until the process exits but leave reaping to reap(), which holds the mutex,
+        // so isAlive() from another thread can't collect the status under our feet
+        siginfo_t info;
+        while (waitid(P_PID, pid, &info, WEXITED | WNOWAIT) == -1 && errno == EINTR) {
+        }
+        reap(0);
+        return exitCode;
+    }
+
+    bool waitFor(std::chrono::milliseconds timeout) override {
+        if (timeout.count() < 0) {
+            wait();
+            return true;
+        }
+
+        auto deadline = std::chrono::steady_clock::now() + timeout;
+        while (!reap(WNOHANG)) {
+            auto left = std::chrono::ceil<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now());
+            if (left.count() <= 0) {
+                return false;
+            }
+            if (pidFd != -1) {
+                pollfd fd = { pidFd, POLLIN, 0 };
+                poll(&fd, 1, (int) std::min<long long>(left.count(), INT_MAX));
+            } else {
+                // No pidfd (older kernels, macOS), check back in short steps
+                std::this_thread::sleep_for(std::min(left, std::chrono::milliseconds(10)));
             }
         }
-        return -1;
+        return true;
+    }
+
+    std::chrono::steady_clock::duration getElapsedTime() override {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (pid <= 0) {
+            return {};
+        }
+        return (running ? std::chrono::steady_clock::now() : endTime) - startTime;
     }
 
 private:
     pid_t pid;
     bool running;
     int exitCode;
-    int outputPipe[2]; // Pipe for reading subprocess output
+    int outputPipe[2] = { -1, -1 }; // Pipe for reading subprocess output
+    int errorPipe[2] = { -1, -1 }; // Pipe for reading subprocess errors
+    int pidFd = -1;
+    std::chrono::steady_clock::time_point startTime;
+    std::chrono::steady_clock::time_point endTime;
+    std::mutex mutex; // Guards running and the exit status, the UI polls isAlive while a thread waits
+
+    // Collects the exit status if the process ended, returns true when it is not running anymore.
+    // Signals are reported like shells do, as 128 + the signal number.
+    bool reap(int options) {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!running) {
+            return true;
+        }
+
+        int status;
+        pid_t result;
+        while ((result = waitpid(pid, &status, options)) == -1 && errno == EINTR) {
+        }
+        if (result == 0) {
+            return false;
+        }
+
+        // Reaped, the pid may be reused from now on and must not be signaled anymore
+        endTime = std::chrono::steady_clock::now();
+        running = false;
+        if (result == pid) {
+            if (WIFEXITED(status)) {
+                exitCode = WEXITSTATUS(status);
+            } else if (WIFSIGNALED(status)) {
+                exitCode = 128 + WTERMSIG(status);
+            }
+        }
+        closePipe(pidFd);
+        return true;
+    }
+
+    // Processes started at the same time (parallel builds) must not inherit each other's pipe,
+    // the reader would only see the end of its output once every other process exited too.
+    // dup2 clears the flag on the child's stdout and stderr.
+    static int openPipe(int fds[2]) {
+#if defined(__linux__) || defined(__FreeBSD__) || defined(__NetBSD__) || defined(__OpenBSD__) || defined(__DragonFly__)
+        // Atomic, a fork on another thread can't see the ends before the flag is set
+        return pipe2(fds, O_CLOEXEC);
+#else
+        if (pipe(fds) == -1) {
+            return -1;
+        }
+        fcntl(fds[0], F_SETFD, FD_CLOEXEC);
+        fcntl(fds[1], F_SETFD, FD_CLOEXEC);
+        return 0;
+#endif
+    }
+
+    void closePipe(int& fd) {
+        if (fd != -1) {
+            close(fd);
+            fd = -1;
+        }
+    }
 
     void tokenize(const std::string &cmd, std::vector<char *> &args) {
         // Simple tokenization function for demonstration
@@ -351,3 +618,124 @@ export using SubProcess = SubProcessPosix;
     #error port to this platform
 #endif
 
+// Watches the output of many processes from one thread. Output is handed over in chunks that end
+// at a line break, so a line is never split across callbacks. A process counts as finished once
+// both its streams are closed, it is then waited for and reported through onExit.
+// Processes have to be created with RedirectOutput, otherwise they are waited for right away.
+export class SubProcessPoller
+{
+public:
+    using OutputCallback = std::function<void(SubProcessStream stream, std::string_view text)>;
+    using ExitCallback = std::function<void(int exitCode)>;
+
+    void add(std::shared_ptr<SubProcess> process, OutputCallback onOutput, ExitCallback onExit) {
+        auto entry = std::make_unique<Entry>();
+        entry->mProcess = std::move(process);
+        entry->mOnOutput = std::move(onOutput);
+        entry->mOnExit = std::move(onExit);
+        mEntries.push_back(std::move(entry));
+    }
+
+    bool empty() const {
+        return mEntries.empty();
+    }
+
+    // Waits at most timeout for output, a negative one waits until something happens.
+    // Callbacks run on the calling thread, onExit may add new processes.
+    void poll(std::chrono::milliseconds timeout) {
+        if (mEntries.empty()) {
+            return;
+        }
+
+#if defined(WIN32)
+        // Anonymous pipes can't be waited on, look at all of them and nap if none had anything
+        bool received = false;
+        for (auto& entry : mEntries) {
+            for (int i = 0; i < 2; i++) {
+                received |= drain(*entry, (SubProcessStream) i);
+            }
+        }
+        if (!received && timeout.count() != 0) {
+            Sleep(1);
+        }
+#else
+        std::vector<pollfd> fds;
+        std::vector<std::pair<Entry*, SubProcessStream>> owners;
+        for (auto& entry : mEntries) {
+            for (int i = 0; i < 2; i++) {
+                if (entry->mOpen[i]) {
+                    fds.push_back({ entry->mProcess->getPipe((SubProcessStream) i), POLLIN, 0 });
+                    owners.emplace_back(entry.get(), (SubProcessStream) i);
+                }
+            }
+        }
+
+        int timeoutMs = timeout.count() < 0 ? -1 : (int) std::min<long long>(timeout.count(), INT_MAX);
+        if (::poll(fds.data(), fds.size(), timeoutMs) > 0) {
+            for (size_t i = 0; i < fds.size(); i++) {
+                if (fds[i].revents != 0) {
+                    drain(*owners[i].first, owners[i].second);
+                }
+            }
+        }
+#endif
+
+        // Take finished entries out before reporting, so onExit is free to add more
+        std::vector<std::unique_ptr<Entry>> finished;
+        for (auto it = mEntries.begin(); it != mEntries.end();) {
+            if (!(*it)->mOpen[0] && !(*it)->mOpen[1]) {
+                finished.push_back(std::move(*it));
+                it = mEntries.erase(it);
+            } else {
+                ++it;
+            }
+        }
+        for (auto& entry : finished) {
+            entry->mOnExit(entry->mProcess->wait());
+        }
+    }
+
+private:
+    struct Entry {
+        std::shared_ptr<SubProcess> mProcess;
+        OutputCallback mOnOutput;
+        ExitCallback mOnExit;
+        std::string mPending[2]; // Incomplete last line of each stream
+        bool mOpen[2] = { true, true };
+    };
+
+    std::vector<std::unique_ptr<Entry>> mEntries;
+
+    // Reads everything available on the stream, returns true if anything arrived
+    bool drain(Entry& entry, SubProcessStream stream) {
+        int index = (int) stream;
+        if (!entry.mOpen[index]) {
+            return false;
+        }
+
+        char buffer[BUFSIZE * 16];
+        std::string& pending = entry.mPending[index];
+        bool received = false;
+        int bytesRead;
+        while ((bytesRead = entry.mProcess->readSome(stream, buffer, sizeof(buffer))) > 0) {
+            received = true;
+            pending.append(buffer, bytesRead);
+
+            size_t lineEnd = pending.rfind('\n');
+            if (lineEnd != std::string::npos) {
+                entry.mOnOutput(stream, std::string_view(pending).substr(0, lineEnd + 1));
+                pending.erase(0, lineEnd + 1);
+            }
+        }
+
+        if (bytesRead == 0) {
+            entry.mOpen[index] = false;
+            if (!pending.empty()) {
+                entry.mOnOutput(stream, pending);
+                pending.clear();
+            }
+        }
+        return received;
+    }
+};
+
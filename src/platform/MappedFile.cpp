@@ -0,0 +1,159 @@
+#include "Stdafx.h"
+#include "MappedFile.h"
+
+#if defined(WIN32)
+
+#include <algorithm>
+#include <windows.h>
+
+#elif defined (__unix__) || (defined (__APPLE__) && defined (__MACH__))
+
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#else
+    #error port to this platform
+#endif
+
+MappedFile::~MappedFile() {
+    close();
+}
+
+#if defined(WIN32)
+
+bool MappedFile::open(const std::filesystem::path& filePath) {
+    close();
+
+    HANDLE file = CreateFileW(filePath.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+        NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file == INVALID_HANDLE_VALUE)
+        return false;
+
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(file, &fileSize)) {
+        CloseHandle(file);
+        return false;
+    }
+
+    // Empty files can't be mapped
+    if (fileSize.QuadPart == 0) {
+        CloseHandle(file);
+        mData = "";
+        return true;
+    }
+
+    // The view keeps the file and the mapping alive, both handles can be closed right away
+    void* view = NULL;
+    HANDLE mapping = CreateFileMappingW(file, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (mapping != NULL) {
+        view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+        CloseHandle(mapping);
+    }
+
+    if (view != NULL) {
+        CloseHandle(file);
+        mData = static_cast<const char*>(view);
+        mSize = static_cast<size_t>(fileSize.QuadPart);
+        return true;
+    }
+
+    // Some files can't be mapped (network shares, devices), read those into memory instead
+    auto size = static_cast<size_t>(fileSize.QuadPart);
+    auto buffer = std::unique_ptr<char[]>(new char[size]);
+    size_t total = 0;
+    while (total < size) {
+        DWORD chunk = static_cast<DWORD>(std::min<size_t>(size - total, 1u << 30));
+        DWORD count = 0;
+        if (!ReadFile(file, buffer.get() + total, chunk, &count, NULL)) {
+            CloseHandle(file);
+            return false;
+        }
+        if (count == 0)
+            break;
+        total += count;
+    }
+    CloseHandle(file);
+
+    mBuffer = std::move(buffer);
+    mData = mBuffer.get();
+    mSize = total;
+    return true;
+}
+
+void MappedFile::close() {
+    if (mBuffer)
+        mBuffer.reset();
+    else if (mSize > 0)
+        UnmapViewOfFile(mData);
+    mData = nullptr;
+    mSize = 0;
+}
+
+#else
+
+bool MappedFile::open(const std::filesystem::path& filePath) {
+    close();
+
+    int fd = ::open(filePath.c_str(), O_RDONLY);
+    if (fd < 0)
+        return false;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        ::close(fd);
+        return false;
+    }
+
+    // Empty files can't be mapped
+    if (st.st_size == 0) {
+        ::close(fd);
+        mData = "";
+        return true;
+    }
+
+    void* view = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+    if (view != MAP_FAILED) {
+        ::close(fd);
+        mData = static_cast<const char*>(view);
+        mSize = static_cast<size_t>(st.st_size);
+        return true;
+    }
+
+    // Some files can't be mapped (FUSE and other file systems without mmap support, devices),
+    // read those into memory instead
+    auto size = static_cast<size_t>(st.st_size);
+    auto buffer = std::unique_ptr<char[]>(new char[size]);
+    size_t total = 0;
+    while (total < size) {
+        ssize_t count = ::read(fd, buffer.get() + total, size - total);
+        if (count < 0 && errno == EINTR)
+            continue;
+        if (count < 0) {
+            ::close(fd);
+            return false;
+        }
+        if (count == 0)
+            break;
+        total += static_cast<size_t>(count);
+    }
+    ::close(fd);
+
+    mBuffer = std::move(buffer);
+    mData = mBuffer.get();
+    mSize = total;
+    return true;
+}
+
+void MappedFile::close() {
+    if (mBuffer)
+        mBuffer.reset();
+    else if (mSize > 0)
+        munmap(const_cast<char*>(mData), mSize);
+    mData = nullptr;
+    mSize = 0;
+}
+
+#endif
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <cstddef>
+#include <filesystem>
+#include <memory>
+
+// Read-only memory mapping of a whole file. The pages are loaded by the OS on first access,
+// so opening a file costs nothing until its content is actually read. The file should not be
+// truncated by another process while it is mapped. Files that can't be mapped are read into
+// memory instead.
+class MappedFile
+{
+public:
+    MappedFile() = default;
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    bool open(const std::filesystem::path& filePath);
+    void close();
+
+    const char* data() const { return mData; }
+    size_t size() const { return mSize; }
+
+private:
+    const char* mData = nullptr;
+    size_t mSize = 0;
+    std::unique_ptr<char[]> mBuffer;
+};
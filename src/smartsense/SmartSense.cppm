@@ -6,7 +6,13 @@ module;
 #include <chrono>
 #include <atomic>
 #include <mutex>
+#include <shared_mutex>
+#include <optional>
+#include <condition_variable>
+#include <algorithm>
+#include <cstring>
 
+#include "MappedFile.h"
 #include <clang-c/Index.h>  // This is libclang.
 
 export module smartsense;
@@ -22,25 +28,159 @@ export enum class SmartSymbolType {
 	Aggregate,
 };
 
+// Strings of all symbols of all files, each stored once and referred to by a 32 bit id. The text
+// lives in large blocks that are never freed or moved, so views and ids stay valid for the whole
+// session. The pool only grows, by the distinct names and calltips the project has.
+export struct SmartStringPool {
+	static constexpr size_t kBlockSize = 64 * 1024;
+
+	mutable std::shared_mutex mMutex;
+	std::vector<std::unique_ptr<char[]>> mBlocks;
+	std::vector<std::unique_ptr<char[]>> mLargeBlocks;
+	size_t mBlockUsed = kBlockSize;
+	size_t mBytes = 0;
+	std::vector<std::string_view> mStrings;
+	std::unordered_map<std::string_view, uint32_t> mIds;
+
+	SmartStringPool() {
+		// Id 0 is the empty string, what a default symbol refers to
+		mStrings.push_back({});
+		mIds[{}] = 0;
+	}
+
+	static SmartStringPool& get() {
+		static SmartStringPool instance;
+		return instance;
+	}
+
+	uint32_t intern(std::string_view str) {
+		{
+			std::shared_lock<std::shared_mutex> lock(mMutex);
+			auto it = mIds.find(str);
+			if (it != mIds.end()) {
+				return it->second;
+			}
+		}
+
+		std::unique_lock<std::shared_mutex> lock(mMutex);
+		auto it = mIds.find(str);
+		if (it != mIds.end()) {
+			return it->second;
+		}
+
+		char* text;
+		if (str.size() > kBlockSize / 4) {
+			// Long strings get a block of their own, the current one stays in use
+			mLargeBlocks.push_back(std::make_unique<char[]>(str.size()));
+			text = mLargeBlocks.back().get();
+		} else {
+			if (mBlockUsed + str.size() > kBlockSize) {
+				mBlocks.push_back(std::make_unique<char[]>(kBlockSize));
+				mBlockUsed = 0;
+			}
+			text = mBlocks.back().get() + mBlockUsed;
+			mBlockUsed += str.size();
+		}
+		return add(text, str);
+	}
+
+	// Id of a string that was interned before, nothing if it never was
+	std::optional<uint32_t> find(std::string_view str) const {
+		std::shared_lock<std::shared_mutex> lock(mMutex);
+		auto it = mIds.find(str);
+		if (it == mIds.end()) {
+			return std::nullopt;
+		}
+		return it->second;
+	}
+
+	std::string_view view(uint32_t id) const {
+		std::shared_lock<std::shared_mutex> lock(mMutex);
+		return mStrings[id];
+	}
+
+	size_t getBytes() const {
+		std::shared_lock<std::shared_mutex> lock(mMutex);
+		return mBytes;
+	}
+
+private:
+	uint32_t add(char* text, std::string_view str) {
+		std::memcpy(text, str.data(), str.size());
+		std::string_view stored(text, str.size());
+		auto id = (uint32_t)mStrings.size();
+		mStrings.push_back(stored);
+		mIds[stored] = id;
+		mBytes += str.size();
+		return id;
+	}
+};
+
 export struct SmartSymbol {
-	std::string mName = "";
+	uint32_t mName = 0;
+	uint32_t mCalltip = 0;
 	SmartSymbolType mType = SmartSymbolType::Invalid;
-	std::string mCalltip = "Call me!";
+	// Where it is declared in its file, 1 based
+	int mLine = 0;
+
+	std::string_view getName() const { return SmartStringPool::get().view(mName); }
+	std::string_view getCalltip() const { return SmartStringPool::get().view(mCalltip); }
 
 	bool isFunction() const { 
 		return mType == SmartSymbolType::Function; 
 	}
 };
 
-export using SmartSymbolPtr = std::shared_ptr<SmartSymbol>;
-export using SymbolMap = std::unordered_map<std::string, SmartSymbolPtr>;
+// Symbols of a file in one block, sorted by name id. Dropping a file's symbols is one free.
+export using SmartSymbolList = std::vector<SmartSymbol>;
+
+// CXIndex is a plain pointer, this releases it once the last translation unit using it is gone
+using SmartIndexPtr = std::shared_ptr<void>;
+
+static SmartIndexPtr CreateIndex() {
+	return SmartIndexPtr(clang_createIndex(1, 0), [] (CXIndex index) { clang_disposeIndex(index); });
+}
+
+// Memory held by a translation unit (AST, preamble, caches) as reported by libclang
+static unsigned long TranslationUnitMemory(CXTranslationUnit unit) {
+	unsigned long bytes = 0;
+	CXTUResourceUsage usage = clang_getCXTUResourceUsage(unit);
+	for (unsigned i = 0; i < usage.numEntries; i++) {
+		bytes += usage.entries[i].amount;
+	}
+	clang_disposeCXTUResourceUsage(usage);
+	return bytes;
+}
+
+// FNV-1a of a file's text, tells whether indexed symbols still match a file whose time changed
+static uint64_t ContentHash(std::string_view text) {
+	uint64_t hash = 14695981039346656037ull;
+	for (char c : text) {
+		hash = (hash ^ (unsigned char)c) * 1099511628211ull;
+	}
+	return hash;
+}
+
+static int64_t ModifiedTime(const std::string& filePath) {
+	std::error_code error;
+	auto time = std::filesystem::last_write_time(filePath, error);
+	return error ? 0 : (int64_t)time.time_since_epoch().count();
+}
 
 export struct SmartSourceFile {
-	CXIndex mIndex = nullptr;
+	SmartIndexPtr mIndex = nullptr;
+	// Parsed by the scan workers, reparsed and completed on the SmartSense thread, always under mMutex
+	std::mutex mMutex;
 	CXTranslationUnit mTransUnit = nullptr;
 
 	std::string mFilePath;
-	SymbolMap mSymbols;
+	// Replaced in whole once a parse has been analysed, read by lookups from any thread
+	std::mutex mSymbolMutex;
+	SmartSymbolList mSymbols;
+	// What mSymbols was built from, kept in the symbol index. A zero time means unsaved text.
+	int64_t mModifiedTime = 0;
+	uint64_t mContentHash = 0;
+	bool mAnalysed = false;
 
 	SmartSourceFile() {
 
@@ -51,35 +191,49 @@ export struct SmartSourceFile {
 			clang_disposeTranslationUnit(mTransUnit);
 			mTransUnit = nullptr;
 		}
-		if (mIndex)
-			clang_disposeIndex(mIndex);
+		// The index goes after the translation unit, other files may still hold it
 		mIndex = nullptr;
 	}
 
-	SymbolMap& getSymbolMap() {
+	SmartSymbolList getSymbols() {
+		std::lock_guard<std::mutex> lock(mSymbolMutex);
 		return mSymbols;
 	}
 
-	const std::string& getFilePath() { return mFilePath; }
-
-	void clearEverything() {
-		mSymbols.clear();
+	std::optional<SmartSymbol> findSymbol(uint32_t name) {
+		std::lock_guard<std::mutex> lock(mSymbolMutex);
+		auto it = std::lower_bound(mSymbols.begin(), mSymbols.end(), name, [] (const SmartSymbol& sym, uint32_t name) {
+			return sym.mName < name;
+		});
+		if (it == mSymbols.end() || it->mName != name) {
+			return std::nullopt;
+		}
+		return *it;
 	}
 
-	SmartSymbolPtr insert(const std::string& name, SmartSymbolType type) {
-		auto sym = std::make_shared<SmartSymbol>();
-		sym->mName = name;
-		sym->mType = type;
-		return insert(sym);
+	// Takes symbols in any order, keeps the first one of each name
+	void setSymbols(SmartSymbolList symbols, int64_t modifiedTime, uint64_t contentHash) {
+		std::stable_sort(symbols.begin(), symbols.end(), [] (const SmartSymbol& a, const SmartSymbol& b) {
+			return a.mName < b.mName;
+		});
+		symbols.erase(std::unique(symbols.begin(), symbols.end(), [] (const SmartSymbol& a, const SmartSymbol& b) {
+			return a.mName == b.mName;
+		}), symbols.end());
+		symbols.shrink_to_fit();
+
+		std::lock_guard<std::mutex> lock(mSymbolMutex);
+		mSymbols.swap(symbols);
+		mModifiedTime = modifiedTime;
+		mContentHash = contentHash;
+		mAnalysed = true;
 	}
 
-	SmartSymbolPtr insert(SmartSymbolPtr sym) {
-		auto it = mSymbols.find(sym->mName);
-		if (it != mSymbols.end()) {
-			return nullptr;
-		}
-		mSymbols[sym->mName] = sym;
-		return sym;
+	const std::string& getFilePath() { return mFilePath; }
+
+	void clearEverything() {
+		std::lock_guard<std::mutex> lock(mSymbolMutex);
+		SmartSymbolList().swap(mSymbols);
+		mAnalysed = false;
 	}
 };
 
@@ -87,20 +241,232 @@ export using SmartSourceFilePtr = std::shared_ptr<SmartSourceFile>;
 export using SourceFileMap = std::unordered_map<std::string, SmartSourceFilePtr>;
 
 export struct SmartDatabase {
+	// Files are added from the full scan workers and looked up from the main thread
+	std::mutex mMutex;
 	SourceFileMap mFiles;
 
 	SmartSourceFilePtr getFile(const std::string& filepath) {
+		std::lock_guard<std::mutex> lock(mMutex);
 		auto it = mFiles.find(filepath);
 		if (it == mFiles.end()) {
 			auto file = std::make_shared<SmartSourceFile>();
+			file->mFilePath = filepath;
 			mFiles[filepath] = file;
 			return file;
 		} else {
 			return it->second;
 		}
 	}
+
+	SourceFileMap getFiles() {
+		std::lock_guard<std::mutex> lock(mMutex);
+		return mFiles;
+	}
+
+	// Looks a function or aggregate up across every file of the project
+	std::optional<SmartSymbol> findSymbol(std::string_view name) {
+		auto id = SmartStringPool::get().find(name);
+		if (!id) {
+			return std::nullopt;
+		}
+		for (auto& [filePath, file] : getFiles()) {
+			if (auto sym = file->findSymbol(*id)) {
+				return sym;
+			}
+		}
+		return std::nullopt;
+	}
 };
 
+// Symbols of every analysed file, saved next to the project file so they are known on the next
+// start before anything is parsed. The file is a header, the file and symbol tables and a string
+// pool; it is mapped and read in place, strings are referenced by offset into the pool.
+namespace SymbolIndex {
+	constexpr char kMagic[4] = { 'P', 'C', 'S', 'I' };
+	constexpr uint32_t kVersion = 2;
+
+	struct Header {
+		char mMagic[4];
+		uint32_t mVersion;
+		uint32_t mFileCount;
+		uint32_t mSymbolCount;
+	};
+
+	struct FileEntry {
+		uint32_t mPath;
+		uint32_t mPathLength;
+		uint32_t mFirstSymbol;
+		uint32_t mSymbolCount;
+		int64_t mModifiedTime;
+		uint64_t mContentHash;
+	};
+
+	struct SymbolEntry {
+		uint32_t mName;
+		uint32_t mNameLength;
+		uint32_t mCalltip;
+		uint32_t mCalltipLength;
+		uint32_t mType;
+		uint32_t mLine;
+	};
+
+	// Indexed symbols stay valid while the file keeps its time, or its text if only the time changed
+	static bool IsCurrent(const std::string& filePath, int64_t modifiedTime, uint64_t contentHash) {
+		if (modifiedTime != 0 && modifiedTime == ModifiedTime(filePath)) {
+			return true;
+		}
+		std::ifstream t(filePath, std::ios::binary);
+		if (!t.good()) {
+			return false;
+		}
+		std::string str((std::istreambuf_iterator<char>(t)), std::istreambuf_iterator<char>());
+		return ContentHash(str) == contentHash;
+	}
+
+	// Fills the database with the symbols of the given files that are still current, returns how many files were loaded
+	static size_t Load(const std::filesystem::path& indexPath, const std::vector<std::string>& files, SmartDatabase& database) {
+		MappedFile mapped;
+		if (!mapped.open(indexPath) || mapped.size() < sizeof(Header)) {
+			return 0;
+		}
+
+		Header header;
+		std::memcpy(&header, mapped.data(), sizeof(Header));
+		if (std::memcmp(header.mMagic, kMagic, sizeof(kMagic)) != 0 || header.mVersion != kVersion) {
+			return 0;
+		}
+
+		size_t filesOffset = sizeof(Header);
+		size_t symbolsOffset = filesOffset + (size_t)header.mFileCount * sizeof(FileEntry);
+		size_t stringsOffset = symbolsOffset + (size_t)header.mSymbolCount * sizeof(SymbolEntry);
+		if (stringsOffset > mapped.size()) {
+			return 0;
+		}
+		std::string_view strings(mapped.data() + stringsOffset, mapped.size() - stringsOffset);
+
+		auto getString = [&strings] (uint32_t offset, uint32_t length, std::string_view& out) {
+			if ((size_t)offset + length > strings.size()) {
+				return false;
+			}
+			out = strings.substr(offset, length);
+			return true;
+		};
+
+		size_t loaded = 0;
+		for (uint32_t i = 0; i < header.mFileCount; i++) {
+			FileEntry entry;
+			std::memcpy(&entry, mapped.data() + filesOffset + i * sizeof(FileEntry), sizeof(FileEntry));
+
+			std::string_view path;
+			if (!getString(entry.mPath, entry.mPathLength, path) ||
+				(size_t)entry.mFirstSymbol + entry.mSymbolCount > header.mSymbolCount) {
+				return loaded;
+			}
+
+			std::string filePath(path);
+			if (std::find(files.begin(), files.end(), filePath) == files.end() ||
+				!IsCurrent(filePath, entry.mModifiedTime, entry.mContentHash)) {
+				continue;
+			}
+
+			SmartStringPool& pool = SmartStringPool::get();
+			SmartSymbolList symbols;
+			symbols.reserve(entry.mSymbolCount);
+			for (uint32_t j = 0; j < entry.mSymbolCount; j++) {
+				SymbolEntry symbolEntry;
+				std::memcpy(&symbolEntry, mapped.data() + symbolsOffset + (entry.mFirstSymbol + j) * sizeof(SymbolEntry), sizeof(SymbolEntry));
+
+				std::string_view name, calltip;
+				if (!getString(symbolEntry.mName, symbolEntry.mNameLength, name) ||
+					!getString(symbolEntry.mCalltip, symbolEntry.mCalltipLength, calltip)) {
+					return loaded;
+				}
+
+				SmartSymbol sym;
+				sym.mName = pool.intern(name);
+				sym.mCalltip = pool.intern(calltip);
+				sym.mType = (SmartSymbolType)symbolEntry.mType;
+				sym.mLine = (int)symbolEntry.mLine;
+				symbols.push_back(sym);
+			}
+			database.getFile(filePath)->setSymbols(std::move(symbols), entry.mModifiedTime, entry.mContentHash);
+			loaded++;
+		}
+		return loaded;
+	}
+
+	// Writes every analysed file of the database, through a temporary file so a crash never leaves half an index
+	static bool Save(const std::filesystem::path& indexPath, SmartDatabase& database) {
+		std::vector<FileEntry> fileEntries;
+		std::vector<SymbolEntry> symbolEntries;
+		std::string strings;
+
+		auto addString = [&strings] (std::string_view str, uint32_t& offset, uint32_t& length) {
+			offset = (uint32_t)strings.size();
+			length = (uint32_t)str.size();
+			strings += str;
+		};
+
+		// Interned strings are written once however many symbols share them
+		std::unordered_map<uint32_t, std::pair<uint32_t, uint32_t>> written;
+		auto addInterned = [&written, &addString] (uint32_t id, uint32_t& offset, uint32_t& length) {
+			auto [it, added] = written.try_emplace(id);
+			if (added) {
+				addString(SmartStringPool::get().view(id), it->second.first, it->second.second);
+			}
+			offset = it->second.first;
+			length = it->second.second;
+		};
+
+		for (auto& [filePath, file] : database.getFiles()) {
+			std::lock_guard<std::mutex> lock(file->mSymbolMutex);
+			if (!file->mAnalysed) {
+				continue;
+			}
+
+			FileEntry entry = {};
+			addString(filePath, entry.mPath, entry.mPathLength);
+			entry.mFirstSymbol = (uint32_t)symbolEntries.size();
+			entry.mSymbolCount = (uint32_t)file->mSymbols.size();
+			entry.mModifiedTime = file->mModifiedTime;
+			entry.mContentHash = file->mContentHash;
+			fileEntries.push_back(entry);
+
+			for (const SmartSymbol& sym : file->mSymbols) {
+				SymbolEntry symbolEntry = {};
+				addInterned(sym.mName, symbolEntry.mName, symbolEntry.mNameLength);
+				addInterned(sym.mCalltip, symbolEntry.mCalltip, symbolEntry.mCalltipLength);
+				symbolEntry.mType = (uint32_t)sym.mType;
+				symbolEntry.mLine = (uint32_t)sym.mLine;
+				symbolEntries.push_back(symbolEntry);
+			}
+		}
+
+		Header header = {};
+		std::memcpy(header.mMagic, kMagic, sizeof(kMagic));
+		header.mVersion = kVersion;
+		header.mFileCount = (uint32_t)fileEntries.size();
+		header.mSymbolCount = (uint32_t)symbolEntries.size();
+
+		std::filesystem::path tempPath = indexPath;
+		tempPath += ".tmp";
+		{
+			std::ofstream out(tempPath, std::ios::binary | std::ios::trunc);
+			out.write((const char*)&header, sizeof(header));
+			out.write((const char*)fileEntries.data(), fileEntries.size() * sizeof(FileEntry));
+			out.write((const char*)symbolEntries.data(), symbolEntries.size() * sizeof(SymbolEntry));
+			out.write(strings.data(), strings.size());
+			if (!out.good()) {
+				return false;
+			}
+		}
+
+		std::error_code error;
+		std::filesystem::rename(tempPath, indexPath, error);
+		return !error;
+	}
+}
+
 export enum class SmartSenseState {
 	Idle,
 	QuickScanning,
@@ -121,24 +487,94 @@ export struct SmartCompletioResult {
 
 export using SmartCompletionCB = std::function<void(std::vector<SmartCompletioResult>)>;
 
+// Immutable copy of an editor's text. The UI thread builds one per text version and shares it,
+// SmartSense only ever keeps the latest one per file.
+export struct SmartDocumentSnapshot {
+	uint64_t mVersion = 0;
+	std::shared_ptr<const std::string> mText;
+};
+
 export struct CompletionRequestArgs {
 	std::string mFilePath;
-	std::string mUnsavedText;
+	SmartDocumentSnapshot mUnsaved;
 	int mLine;
 	int mColumn;
 	std::vector<SmartCompletioResult> mResult;
 };
 
+// Completion request serviced by the SmartSense thread. Results are appended in batches while they
+// are collected, the editor takes what has arrived every frame until mDone is set.
+export struct SmartCompletionRequest {
+	CompletionRequestArgs mArgs;
+	std::atomic_bool mCancelled = false;
+	std::atomic_bool mDone = false;
+
+	std::mutex mMutex;
+	std::vector<SmartCompletioResult> mResults;
+
+	// Appends the results that arrived since the last call, returns true once there are no more
+	bool takeResults(std::vector<SmartCompletioResult>& results) {
+		bool done = mDone;
+		std::lock_guard<std::mutex> lock(mMutex);
+		std::move(mResults.begin(), mResults.end(), std::back_inserter(results));
+		mResults.clear();
+		return done;
+	}
+};
+
+export using SmartCompletionRequestPtr = std::shared_ptr<SmartCompletionRequest>;
+
 export struct SmartSense {
 
 	std::jthread mThread;
 	std::atomic_bool mTerminate = false;
-	std::map<std::string, std::string> mFilesModified;
-	int mQuckScanInterval = 0;
-	std::mutex string_mutex;
-	std::string mCurrentParsingFileName = "";
 
-	SmartSenseState mState = SmartSenseState::Idle;
+	// Modified files waiting for a reparse, guarded by mQueueMutex. The worker sleeps on
+	// mQueueCondition until a file is queued and then waits until the edits have been quiet
+	// for mReparseDelay, so typing doesn't trigger a reparse per keystroke.
+	std::mutex mQueueMutex;
+	std::condition_variable mQueueCondition;
+	std::map<std::string, SmartDocumentSnapshot> mFilesModified;
+	std::chrono::steady_clock::time_point mLastModified;
+	std::chrono::milliseconds mReparseDelay = 700ms;
+	// Latest completion request, a newer one cancels it. Guarded by mQueueMutex as well.
+	SmartCompletionRequestPtr mCompletionRequest = nullptr;
+	// Files being parsed right now and the full scan progress, shown in the status bar
+	std::mutex string_mutex;
+	std::vector<std::string> mParsingFiles;
+	std::atomic<size_t> mScanDone = 0;
+	std::atomic<size_t> mScanTotal = 0;
+
+	// Threads parsing translation units during a full scan, 0 picks one per core but one up to
+	// kDefaultScanThreads. Every thread holds a whole AST and its preamble, so more cost a lot of memory.
+	static constexpr unsigned kDefaultScanThreads = 4;
+	unsigned mScanThreads = 0;
+	// Files open in editors, parsed before the rest of the project
+	std::vector<std::string> mPriorityFiles;
+
+	// With mSharedIndex, translation units parsed with the same flags on the same thread share one
+	// CXIndex instead of creating one each. libclang doesn't guard an index against parses on several
+	// threads, so every scan worker has its own. Indexes are keyed by thread and joined flags, guarded
+	// by mIndexMutex, and the count of the last full scan goes to the log.
+	bool mSharedIndex = true;
+	std::mutex mIndexMutex;
+	std::map<std::pair<std::thread::id, std::string>, SmartIndexPtr> mIndexes;
+	std::atomic<size_t> mScanIndexes = 0;
+	// Parse totals of the last full scan, for the log
+	std::atomic<unsigned long> mScanMemory = 0;
+
+	// Functions and aggregates of each file are collected after every parse and kept in the
+	// symbol index next to the project file, saved whenever mIndexDirty is set
+	bool mAnalyseSymbols = true;
+	std::filesystem::path mIndexPath;
+	std::atomic_bool mIndexDirty = false;
+	// Grows whenever the symbols of a file change, so lookups built from them know to rebuild
+	std::atomic<uint64_t> mSymbolsVersion = 0;
+
+	std::atomic<SmartSenseState> mState = SmartSenseState::Idle;
+
+	// Called from the SmartSense thread whenever the state or file shown in the status bar changes
+	std::function<void()> mStateCallback;
 
 	// This object needs to be 'thread-safe' since this will be 
 	// accessed by both smart sense thread and our main thread
@@ -158,8 +594,6 @@ export struct SmartSense {
 
 		mThread = std::jthread([this] () {
 
-			mCurrentParsingFileName = "";
-
 			fullScan();
 			while(!mTerminate) {
 				scan();
@@ -174,59 +608,212 @@ export struct SmartSense {
 	}
 
 	void terminate() {
-		mTerminate = true;
+		{
+			std::lock_guard<std::mutex> lock(mQueueMutex);
+			mTerminate = true;
+		}
+		mQueueCondition.notify_all();
+
+		// The scan uses the members of this object, wait for it before they are destroyed
+		if (mThread.joinable())
+			mThread.join();
 		cleanUp();
 	}
 
-	std::string getCurrentFileName() {
-		return mCurrentParsingFileName;
+	void setReparseDelay(std::chrono::milliseconds delay) {
+		{
+			std::lock_guard<std::mutex> lock(mQueueMutex);
+			mReparseDelay = delay;
+		}
+		mQueueCondition.notify_all();
+	}
+
+	std::vector<std::string> getParsingFiles() {
+		std::unique_lock<std::mutex> lock(string_mutex);
+		return mParsingFiles;
 	}
 
+	size_t getScanDone() const { return mScanDone; }
+	size_t getScanTotal() const { return mScanTotal; }
+
 	SmartDatabase& getDatabase() {
 		return mDatabase;
 	}
 
 	SmartSenseState getState() const { return mState; }
 
+	uint64_t getSymbolsVersion() const { return mSymbolsVersion; }
+
+	void setState(SmartSenseState state) {
+		mState = state;
+		notifyStateChanged();
+	}
+
+	void notifyStateChanged() {
+		if (mStateCallback) {
+			mStateCallback();
+		}
+	}
+
 	void fullScan() {
-		mState = SmartSenseState::FullScanning;
+		setState(SmartSenseState::FullScanning);
 		std::cout << "SmartSense: Full scanning...." << std::endl;
 		ProjectPtr project = Manager::get().getActiveProject();
 		if (project) {
+			std::vector<std::string> files;
 			for (ProjectFilePtr file : project->mFileList) {
+				files.push_back(file->getAbsolutePath(project).string());
+			}
 
-				if (mTerminate) {
-					break;
+			// Symbols from the last session are usable while the files are parsed again
+			mIndexPath = project->getFilePath();
+			mIndexPath.replace_extension(".symbols");
+			auto loadStart = std::chrono::steady_clock::now();
+			size_t loaded = SymbolIndex::Load(mIndexPath, files, mDatabase);
+			auto loadTime = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - loadStart);
+			std::cout << std::format("SmartSense: Loaded symbols of {} file(s) from the index in {} ms", loaded, loadTime.count()) << std::endl;
+			mSymbolsVersion++;
+			notifyStateChanged();
+
+			// Files open in editors first, that's where completion is asked for
+			std::stable_partition(files.begin(), files.end(), [this] (const std::string& file) {
+				return std::find(mPriorityFiles.begin(), mPriorityFiles.end(), file) != mPriorityFiles.end();
+			});
+
+			mScanDone = 0;
+			mScanTotal = files.size();
+			mScanMemory = 0;
+			mScanIndexes = 0;
+			auto scanStart = std::chrono::steady_clock::now();
+
+			unsigned threadCount = mScanThreads;
+			if (threadCount == 0) {
+				threadCount = std::clamp(std::thread::hardware_concurrency(), 2u, kDefaultScanThreads + 1) - 1;
+			}
+			threadCount = (unsigned)std::min<size_t>(threadCount, files.size());
+
+			// Every file has its own translation unit, so the workers share nothing but the
+			// database, the indexes and the next file to take
+			std::atomic<size_t> next = 0;
+			std::atomic<unsigned> running = threadCount;
+			{
+				std::vector<std::jthread> workers;
+				for (unsigned i = 0; i < threadCount; i++) {
+					workers.emplace_back([this, &files, &next, &running] () {
+						for (size_t index = next++; index < files.size() && !mTerminate; index = next++) {
+							std::ifstream t(files[index]);
+						    if (t.good()) {
+						        std::string str((std::istreambuf_iterator<char>(t)), std::istreambuf_iterator<char>());
+						        t.close();
+
+								std::cout << "SmartSense: Parse: " << files[index] << std::endl;
+								parseFile(files[index], str);
+							}
+							mScanDone++;
+							notifyStateChanged();
+						}
+						releaseIndexes();
+						{
+							std::lock_guard<std::mutex> lock(mQueueMutex);
+							running--;
+						}
+						mQueueCondition.notify_all();
+					});
 				}
 
-				auto filePath = file->getAbsolutePath(project);
+				// Completion doesn't wait for the scan, files already parsed can answer it
+				while (serviceCompletion([&running] () { return running == 0; })) {
+				}
+			}
+			auto scanTime = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - scanStart);
+			std::cout << std::format("SmartSense: Done scanning {} file(s) in {} ms, {} index(es), {:.1f} MB held by translation units",
+				files.size(), scanTime.count(), mScanIndexes.load(), mScanMemory / (1024.0 * 1024.0)) << std::endl;
 
-				std::ifstream t(filePath);
-			    if (t.good()) {
-			        std::string str((std::istreambuf_iterator<char>(t)), std::istreambuf_iterator<char>());
-			        t.close();
+			std::cout << std::format("SmartSense: {:.1f} KB of interned symbol strings", SmartStringPool::get().getBytes() / 1024.0) << std::endl;
 
-					std::cout << "SmartSense: Parse: " << file->getFileName() << std::endl;
-					parseFile(filePath.string(), str);
-				}
+			saveSymbolIndex();
+		}
+		setState(SmartSenseState::Idle);
+	}
+
+	void beginParsing(const std::string& filePath) {
+		{
+			std::unique_lock<std::mutex> lock(string_mutex);
+			mParsingFiles.push_back(filePath);
+		}
+		notifyStateChanged();
+	}
+
+	void endParsing(const std::string& filePath) {
+		std::unique_lock<std::mutex> lock(string_mutex);
+		auto it = std::find(mParsingFiles.begin(), mParsingFiles.end(), filePath);
+		if (it != mParsingFiles.end()) {
+			mParsingFiles.erase(it);
+		}
+	}
+
+	// Queues a completion request for the SmartSense thread, replacing (and cancelling) a pending one
+	SmartCompletionRequestPtr requestCodeComplete(CompletionRequestArgs args) {
+		auto request = std::make_shared<SmartCompletionRequest>();
+		request->mArgs = std::move(args);
+		{
+			std::lock_guard<std::mutex> lock(mQueueMutex);
+			if (mCompletionRequest) {
+				mCompletionRequest->mCancelled = true;
+				mCompletionRequest->mDone = true;
+			}
+			mCompletionRequest = request;
+		}
+		mQueueCondition.notify_all();
+		return request;
+	}
+
+	// Waits until a completion request comes in or stop() returns true and services the request.
+	// Returns false once stop() is true or SmartSense is terminating.
+	bool serviceCompletion(std::function<bool()> stop) {
+		SmartCompletionRequestPtr request;
+		{
+			std::unique_lock<std::mutex> lock(mQueueMutex);
+			mQueueCondition.wait(lock, [&] () { return mTerminate || mCompletionRequest || stop(); });
+			if (!mCompletionRequest) {
+				return false;
 			}
-			std::cout << "SmartSense: Done scanning" << std::endl;
+			request = std::move(mCompletionRequest);
 		}
-		mState = SmartSenseState::Idle;
+		codeComplete(*request);
+		return !mTerminate;
+	}
+
+	// Services a pending completion request, if there is one, without waiting
+	void servicePendingCompletion() {
+		serviceCompletion([] () { return true; });
 	}
 
-	void requestCodeCompleteAt(const CompletionRequestArgs& args, std::vector<SmartCompletioResult>& results) {
+	void codeComplete(SmartCompletionRequest& request) {
+		const CompletionRequestArgs& args = request.mArgs;
+
+		if (request.mCancelled) {
+			request.mDone = true;
+			return;
+		}
+
 		std::cout << std::format("SmartSense: Request! ({} : {})",  args.mLine,  args.mColumn) << std::endl;
-		//mCurrentRequest = std::make_shared<CompletionRequest>();
-		//mCurrentRequest->mCallback = cb;
 		const char* filename = args.mFilePath.c_str();
 
 		CXUnsavedFile unsaved_files;
 		unsaved_files.Filename = filename;
-		unsaved_files.Contents = args.mUnsavedText.c_str();
-		unsaved_files.Length   = args.mUnsavedText.length();
+		unsaved_files.Contents = args.mUnsaved.mText->c_str();
+		unsaved_files.Length   = args.mUnsaved.mText->length();
 
 		SmartSourceFilePtr smartFile = mDatabase.getFile(args.mFilePath);
+		std::unique_lock<std::mutex> fileLock(smartFile->mMutex);
+
+		if (!smartFile->mTransUnit) {
+			std::cout << "SmartSense: CodeComplete: File is not parsed (yet)" << std::endl;
+			request.mDone = true;
+			notifyStateChanged();
+			return;
+		}
 
 		std::cout << "SmartSense: CodeComplete: Query Start..." << std::endl;
 
@@ -237,18 +824,20 @@ export struct SmartSense {
 
 		std::cout << "SmartSense: CodeComplete: Query End" << std::endl;
 
-		if (ccResults) {
+		fileLock.unlock();
 
-			if (!results.empty())
-				results.clear();
+		// Converting thousands of results takes a while, hand them over in batches so the
+		// popup fills up progressively
+		const unsigned batchSize = 256;
+		std::vector<SmartCompletioResult> results;
 
-			std::cout << "SmartSense: CodeComplete: Collect Results..." << std::endl;
+		if (ccResults) {
 
-			auto context = clang_codeCompleteGetContexts(ccResults);
+			std::cout << "SmartSense: CodeComplete: Collect Results..." << std::endl;
 
-			results.reserve(ccResults->NumResults);
+			results.reserve(batchSize);
 
-			for(int i = 0;i < ccResults->NumResults;i++) {
+			for (unsigned i = 0; i < ccResults->NumResults && !request.mCancelled; i++) {
 				CXCompletionResult* result = &ccResults->Results[i];
 
 				const CXCursorKind kind = result->CursorKind;
@@ -259,8 +848,6 @@ export struct SmartSense {
                 	continue;
                 }
 
-                std::string strkind = Convert(clang_getCursorKindSpelling(kind));
-
                 SmartCompletioResult reqResult;
 
 				const int chunkCount = clang_getNumCompletionChunks(string);
@@ -271,7 +858,6 @@ export struct SmartSense {
 	                if (chunkKind == CXCompletionChunk_TypedText) {
 	                	reqResult.mName = text;
 	                	reqResult.mSignature += text;
-	                    //std::cout << "result: " << text << std::endl;
 	                } else {
 	                    reqResult.mSignature += text;
                     	if (chunkKind == CXCompletionChunk_ResultType) {
@@ -279,40 +865,89 @@ export struct SmartSense {
                     	}
 	                }
 	            }
-	            results.push_back(reqResult);
-	            //std::string strComment = Convert(clang_getCompletionBriefComment(string));
-				//std::cout << "result: " << strkind << ", comment: " << strComment << std::endl;
+	            results.push_back(std::move(reqResult));
+
+	            if (results.size() == batchSize) {
+	            	{
+	            		std::lock_guard<std::mutex> lock(request.mMutex);
+	            		std::move(results.begin(), results.end(), std::back_inserter(request.mResults));
+	            	}
+	            	results.clear();
+	            	notifyStateChanged();
+	            }
 			}
 
 			clang_disposeCodeCompleteResults(ccResults);
 
 			std::cout << "SmartSense: CodeComplete: Results Collected" << std::endl;
 		}
+
+		{
+			std::lock_guard<std::mutex> lock(request.mMutex);
+			std::move(results.begin(), results.end(), std::back_inserter(request.mResults));
+		}
+		request.mDone = true;
+		notifyStateChanged();
+	}
+
+	SmartIndexPtr getIndex(const char* const* args, int argCount) {
+		if (!mSharedIndex) {
+			mScanIndexes++;
+			return CreateIndex();
+		}
+
+		std::string key;
+		for (int i = 0; i < argCount; i++) {
+			key += args[i];
+			key += '\n';
+		}
+
+		std::lock_guard<std::mutex> lock(mIndexMutex);
+		auto& index = mIndexes[{ std::this_thread::get_id(), key }];
+		if (!index) {
+			index = CreateIndex();
+			mScanIndexes++;
+		}
+		return index;
+	}
+
+	// Forgets the indexes of a thread about to end, so a later thread reusing its id can't share
+	// them. The files parsed on them keep them alive.
+	void releaseIndexes() {
+		std::lock_guard<std::mutex> lock(mIndexMutex);
+		std::erase_if(mIndexes, [id = std::this_thread::get_id()] (const auto& entry) {
+			return entry.first.first == id;
+		});
 	}
 
 	bool parseFile(const std::string& filePath, const std::string& fullText) {
 
 		const char* filename = filePath.c_str();
 
-		if (!filePath.empty()) {
-			std::unique_lock<std::mutex> lock(string_mutex);
-			mCurrentParsingFileName = filePath;
-		}
+		beginParsing(filePath);
 
+		// Symbols stay in place until the new parse has been analysed
 		SmartSourceFilePtr smartFile = mDatabase.getFile(filePath);
-		smartFile->clearEverything();
+
+		// No compile flags are passed yet, so files share the index of the thread parsing them
+		const char* const* args = nullptr;
+		int argCount = 0;
 
 		if (!smartFile->mIndex)
-			smartFile->mIndex = clang_createIndex(1, 0);
+			smartFile->mIndex = getIndex(args, argCount);
+
+		auto parseStart = std::chrono::steady_clock::now();
 
 		//printf("path %s\n", smartFile->mUnsavedFile.Filename);
 
+		std::unique_lock<std::mutex> fileLock(smartFile->mMutex);
+
 		if (smartFile->mTransUnit)
 			clang_disposeTranslationUnit(smartFile->mTransUnit);
 
 		smartFile->mTransUnit  = clang_parseTranslationUnit(
-								smartFile->mIndex,
-								filename, nullptr, 0,
+								smartFile->mIndex.get(),
+								filename, args, argCount,
 								nullptr, 0,
 								/*CXTranslationUnit_DetailedPreprocessingRecord |*/
 					            CXTranslationUnit_Incomplete |
@@ -326,31 +961,60 @@ export struct SmartSense {
 		if (smartFile->mTransUnit == nullptr) {
 			std::cout << "SmartSense: Unable to parse translation unit. Quitting." << std::endl;
 		} else {
+			auto parseTime = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - parseStart);
+			auto memory = TranslationUnitMemory(smartFile->mTransUnit);
+			mScanMemory += memory;
+			std::cout << std::format("SmartSense: Parsed {} in {} ms, {:.1f} MB", filePath, parseTime.count(), memory / (1024.0 * 1024.0)) << std::endl;
 
-			bool analyze = false;
-
-			if (analyze) {
-				analyseFile(smartFile);
+			if (mAnalyseSymbols) {
+				updateSymbols(smartFile, ModifiedTime(filePath), ContentHash(fullText));
 			}
 		}
+		endParsing(filePath);
 		return true;
 	}
 
-	void analyseFile(SmartSourceFilePtr smartFile) {
+	// Re-analyses a parsed file unless its text is the one its symbols were built from.
+	// The translation unit must be locked by the caller.
+	void updateSymbols(SmartSourceFilePtr smartFile, int64_t modifiedTime, uint64_t contentHash) {
+		{
+			std::lock_guard<std::mutex> lock(smartFile->mSymbolMutex);
+			if (smartFile->mAnalysed && smartFile->mContentHash == contentHash) {
+				smartFile->mModifiedTime = modifiedTime;
+				return;
+			}
+		}
 
-		SmartSourceFile* smartFileRawPtr = smartFile.get();
+		SmartSymbolList symbols;
+		analyseFile(smartFile->mTransUnit, symbols);
+		smartFile->setSymbols(std::move(symbols), modifiedTime, contentHash);
+		mIndexDirty = true;
+		mSymbolsVersion++;
+	}
 
-		CXCursor cursor = clang_getTranslationUnitCursor(smartFile->mTransUnit); //Obtain a cursor at the root of the translation unit
+	void saveSymbolIndex() {
+		if (!mIndexDirty || mIndexPath.empty()) {
+			return;
+		}
+		mIndexDirty = false;
+		if (!SymbolIndex::Save(mIndexPath, mDatabase)) {
+			std::cout << "SmartSense: Unable to write the symbol index " << mIndexPath << std::endl;
+		}
+	}
+
+	void analyseFile(CXTranslationUnit unit, SmartSymbolList& symbols) {
+
+		CXCursor cursor = clang_getTranslationUnitCursor(unit); //Obtain a cursor at the root of the translation unit
 
 		clang_visitChildren(cursor, [](CXCursor current_cursor, CXCursor parent, CXClientData client_data) {
 
-			SmartSourceFile* smartFileRawPtr = (SmartSourceFile*)client_data;
+			SmartSymbolList& symbols = *(SmartSymbolList*)client_data;
 
 			CXSourceLocation location = clang_getCursorLocation( current_cursor );
 
-			// Let's only care about this file symbols (no include files staffs i guess)
-		  	//if( clang_Location_isFromMainFile( location ) == 0 )
-		    	//return CXChildVisit_Continue;
+			// Only this file's symbols, the included ones are indexed with their own file
+		  	if( clang_Location_isFromMainFile( location ) == 0 )
+		    	return CXChildVisit_Continue;
 
 		    CXCursorKind cursor_kind = clang_getCursorKind(current_cursor);
 
@@ -408,11 +1072,16 @@ export struct SmartSense {
 
 		      	//std::cout <<  "Name: " << cursor_name << std::endl;
 
-		      	SmartSymbolPtr sym = smartFileRawPtr->insert(cursor_name, 
-		      		cursor_kind == CXCursor_FunctionDecl ? SmartSymbolType::Function : SmartSymbolType::Aggregate);
-
-		      	if (sym) {
-		      		sym->mCalltip = calltip;
+		      	if (!cursor_name.empty()) {
+		      		// Repeated names (declaration then definition) are dropped by setSymbols
+		      		SmartSymbol sym;
+		      		sym.mName = SmartStringPool::get().intern(cursor_name);
+		      		sym.mType = cursor_kind == CXCursor_FunctionDecl ? SmartSymbolType::Function : SmartSymbolType::Aggregate;
+		      		sym.mCalltip = SmartStringPool::get().intern(calltip);
+		      		unsigned line = 0;
+		      		clang_getSpellingLocation(location, nullptr, &line, nullptr, nullptr);
+		      		sym.mLine = (int)line;
+		      		symbols.push_back(sym);
 		      	}
 
 		      	//std::cout << std::endl;
@@ -434,70 +1103,105 @@ export struct SmartSense {
 		    }
 		    return CXChildVisit_Recurse;
 		    //return CXChildVisit_Continue;
-		}, smartFileRawPtr);
+		}, &symbols);
 	}
 
 	void notifyFileAdded(const std::string& filePath, const std::string& fullText) {
 		
 	}
 
-	void notifyFileModified(const std::string& filePath, const std::string& fullText) {
-		mFilesModified[filePath] = fullText;
-		mQuckScanInterval = 0;
+	// Only the snapshot pointer is handed over under the lock, the text itself is never copied
+	void notifyFileModified(const std::string& filePath, SmartDocumentSnapshot snapshot) {
+		{
+			std::lock_guard<std::mutex> lock(mQueueMutex);
+			auto& latest = mFilesModified[filePath];
+			if (latest.mText && latest.mVersion >= snapshot.mVersion) {
+				return;
+			}
+			latest = std::move(snapshot);
+			mLastModified = std::chrono::steady_clock::now();
+		}
+		mQueueCondition.notify_one();
+	}
+
+	// Blocks until a completion request comes in or modified files have been quiet for mReparseDelay,
+	// returns false on terminate
+	bool waitForWork(std::map<std::string, SmartDocumentSnapshot>& files) {
+		std::unique_lock<std::mutex> lock(mQueueMutex);
+		while (!mTerminate && !mCompletionRequest) {
+			if (mFilesModified.empty()) {
+				mQueueCondition.wait(lock);
+				continue;
+			}
+
+			// Every new modification moves the deadline
+			auto deadline = mLastModified + mReparseDelay;
+			if (std::chrono::steady_clock::now() >= deadline) {
+				files.swap(mFilesModified);
+				break;
+			}
+			mQueueCondition.wait_until(lock, deadline);
+		}
+		return !mTerminate;
 	}
 
 	// Quick Scan modified files (Reparse)
 	void scan() {
-		if (mFilesModified.empty()) {
+		std::map<std::string, SmartDocumentSnapshot> filesModified;
+		if (!waitForWork(filesModified)) {
 			return;
-		} else {
-			// OKay so we have file(s) that has been modified and
-			// We need to parse them again
-			// Let's not hurry too much (to ensure lag-free typing)
-			std::this_thread::sleep_for(500ms);
-			mQuckScanInterval++;
-			if (mQuckScanInterval < 5) {
-				return;
-			}
 		}
 
-		mState = SmartSenseState::QuickScanning;
+		servicePendingCompletion();
+		if (filesModified.empty()) {
+			return;
+		}
+
+		setState(SmartSenseState::QuickScanning);
 
-		for (auto [filePath, smartFile] : mDatabase.mFiles) {
+		for (auto [filePath, smartFile] : mDatabase.getFiles()) {
 			if (mTerminate) {
 				break;
 			}
 
-			auto it = mFilesModified.find(filePath);
+			auto it = filesModified.find(filePath);
 
 			const char* filename = filePath.c_str();
 
-			if (it != mFilesModified.end()) {
+			if (it != filesModified.end()) {
+
+				// Don't keep the user waiting for the whole batch of reparses
+				servicePendingCompletion();
 
 				std::cout << "SmartSense: ReParse: " << filePath << std::endl;
 
-				if (!filePath.empty()) {
-					std::unique_lock<std::mutex> lock(string_mutex);
-					mCurrentParsingFileName = filePath;
-				}
+				beginParsing(filePath);
 
 				CXUnsavedFile unsaved_files;
 				unsaved_files.Filename = filename;
-				unsaved_files.Contents = it->second.c_str();
-				unsaved_files.Length   = it->second.length();
+				unsaved_files.Contents = it->second.mText->c_str();
+				unsaved_files.Length   = it->second.mText->length();
 
+				std::unique_lock<std::mutex> fileLock(smartFile->mMutex);
 				auto ret = clang_reparseTranslationUnit(smartFile->mTransUnit, 1, &unsaved_files,
                              clang_defaultReparseOptions(smartFile->mTransUnit));
+				if (ret == 0 && mAnalyseSymbols) {
+					// The editor text may not be saved, only its hash can tell the index is still current
+					updateSymbols(smartFile, 0, ContentHash(*it->second.mText));
+				}
+				fileLock.unlock();
 
 				std::cout << "SmartSense: Done ReParsing: " << ret << std::endl;
+				endParsing(filePath);
 
-				mFilesModified.erase(it);
+				filesModified.erase(it);
 			}
 		}
-		for (const auto& [file, code] : mFilesModified) {
+		for (const auto& [file, code] : filesModified) {
 			std::cout << "SmartSense: Modified file: '" << file << "' does not exist in project." << std::endl;
 		}
-		mState = SmartSenseState::Idle;
+		saveSymbolIndex();
+		setState(SmartSenseState::Idle);
 	}
 };
 